@@ -2,6 +2,7 @@
 #define ALLOCATOR_H
 
 #include "ir/tac.h"
+#include "ir/cfg.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -9,6 +10,7 @@
 #include <set>
 #include <algorithm>
 #include <climits>
+#include <cmath>
 #include <cctype>
 
 // RISC-V 32-bit register categories
@@ -36,27 +38,36 @@ struct RegInfo
     bool allocatable; // false for zero (x0), ra, sp, gp, tp
 };
 
+// Register allocation result for each instruction position, shared by all
+// allocators and consumed by RISC32Generator
+// A variable with both a register and a stack offset lives in the register
+// and is written through to its slot on every definition.
+struct InstrAlloc
+{
+    std::unordered_map<std::string, std::string> reg_map;    // var -> register
+    std::unordered_map<std::string, int> spill_offset;       // var -> stack offset
+    std::vector<std::string> reload;                         // vars to load from their slot into their register first
+    std::vector<std::string> caller_saved;                   // at a CALL: caller-saved registers live across it
+    std::vector<std::string> write_back;                     // vars to store from their register into their slot first
+    std::unordered_map<std::string, std::string> remat;      // var -> constant recomputed instead of kept in a slot
+};
+
 class LinearScanAllocator
 {
 public:
-    // Register allocation result for each instruction position
-    struct InstrAlloc
-    {
-        std::unordered_map<std::string, std::string> reg_map;    // var -> register
-        std::unordered_map<std::string, int> spill_offset;       // var -> stack offset
-    };
+    using InstrAlloc = ::InstrAlloc;
 
     LinearScanAllocator(FunctionIR *func)
         : func_(func)
     {
         init_registers();
-        // 只分配可用的临时寄存器和保存寄存器
-        // 排除a0-a7（用于参数和返回值）和特殊寄存器
-        // 也排除s0（用作帧指针）
+        // 分配临时寄存器、保存寄存器和参数寄存器，排除特殊寄存器和
+        // t0/t1（代码生成的临时寄存器）；帧按sp寻址，s0是普通的被调用者保存寄存器。
+        // a0-a7在取参和调用处有固定区间，见reserve_argument_registers
         available_regs_.clear();
         for (const auto &r : all_regs_)
         {
-            if (r.allocatable && r.category != RegCategory::ARG && r.name != "s0")
+            if (r.allocatable && r.name != "t0" && r.name != "t1")
             {
                 available_regs_.push_back(r);
             }
@@ -152,20 +163,55 @@ private:
     // Available registers for allocation (excluding ARG category)
     std::vector<RegInfo> available_regs_;
 
-    // Active intervals for linear scan
+    // 区间中一段连续活跃的范围（闭区间，指令下标）
+    struct LiveRange
+    {
+        int start;
+        int end;
+        std::string reg;   // 第二次机会分配时每段可以有自己的寄存器（空表示在栈上）
+        bool write_through = true;  // 段内的定义是否写回栈槽
+        bool write_back = false;    // 段的最后一条指令（循环出口）处把寄存器写回栈槽
+    };
+
+    // Live interval with lifetime holes: the ranges are sorted and disjoint
     struct Interval
     {
         std::string var;
         int start;         // First instruction where live
         int end;           // Last instruction where live
         int length;        // Live range length (end - start)
-        std::string reg;   // Assigned register (empty if spilled)
-        int spill_offset;  // Stack offset if spilled
+        std::string reg;   // Assigned register (empty if spilled or split)
+        int spill_offset;  // Stack offset if spilled or split
         bool is_user_var;  // Is this a user-defined variable?
+        double weight;     // 溢出代价：每次使用和定义按 10^循环深度 计
+        std::string remat; // 只由LOAD_IMM定义的值：溢出时在使用处重新li，不占栈槽
+        std::vector<LiveRange> ranges;
+    };
+
+    // 在线性指令序列中连续的自然循环，用于在循环边界拆分区间
+    struct LoopSpan
+    {
+        std::set<int> body;  // 循环中的基本块
+        int lo;              // 前置块的最后一条指令，值在这里装入寄存器
+        int hi;              // 循环的最后一条指令
+        int depth;
     };
 
     std::vector<Interval> intervals_;
-    std::set<size_t> active_; // Set of active interval indices
+    // 每个寄存器当前被占用的范围
+    std::vector<std::vector<std::pair<int, int>>> reg_occupied_;
+    // 每个栈槽当前被占用的范围
+    std::vector<std::vector<std::pair<int, int>>> slot_occupied_;
+    // CALL指令的位置（升序）和所在块的循环权重
+    std::vector<int> call_sites_;
+    std::vector<double> call_weights_;
+    // 外层循环在前
+    std::vector<LoopSpan> loops_;
+    // 寄存器提示：变量 -> 希望使用的物理寄存器
+    std::unordered_map<std::string, std::vector<std::string>> reg_hints_;
+    // 复制指令两端的变量，另一端已分配的寄存器也作为提示
+    std::unordered_map<std::string, std::vector<std::string>> copy_partners_;
+    std::unordered_map<std::string, std::string> assigned_;
 
     void init_registers()
     {
@@ -179,7 +225,7 @@ private:
             {"t0", RegCategory::TEMP, true, true},    // x5
             {"t1", RegCategory::TEMP, true, true},    // x6
             {"t2", RegCategory::TEMP, true, true},    // x7
-            {"s0", RegCategory::SAVE, false, true},   // x8 - saved register (frame pointer)
+            {"s0", RegCategory::SAVE, false, true},   // x8 - saved register
             {"s1", RegCategory::SAVE, false, true},   // x9
             {"a0", RegCategory::ARG, true, true},     // x10 - also return value
             {"a1", RegCategory::ARG, true, true},     // x11
@@ -212,245 +258,600 @@ private:
         return !var.empty() && var[0] != '.';
     }
 
-    // Compute live ranges for all variables - 改进版本
+    // Compute live intervals with holes from block liveness
+    // 基本块按指令顺序线性化；每个块内从出口活跃集合倒序扫描，
+    // 变量死亡的区域就是区间中的空洞
     void compute_live_ranges()
     {
         intervals_.clear();
-
-        // 首先收集所有变量
-        std::unordered_set<std::string> all_vars;
-        for (const auto &instr : func_->instrs)
+        func_->build_cfg();
+        func_->compute_liveness();
+        func_->compute_dominators();
+        func_->compute_loop_depths();
+        compute_loops();
+
+        call_sites_.clear();
+        call_weights_.clear();
+        for (const auto &block : func_->blocks)
         {
-            if (!is_number(instr.dest))
-                all_vars.insert(instr.dest);
-            if (!is_number(instr.src1))
-                all_vars.insert(instr.src1);
-            if (!is_number(instr.src2))
-                all_vars.insert(instr.src2);
+            for (int i = block.start_idx; i <= block.end_idx; i++)
+            {
+                if (func_->instrs[i].op != TacOp::CALL)
+                    continue;
+                call_sites_.push_back(i);
+                call_weights_.push_back(std::pow(10.0, std::min(block.loop_depth, 8)));
+            }
         }
 
-        // 对每个变量计算其活跃范围
-        for (const auto &var : all_vars)
+        std::unordered_map<std::string, std::vector<std::pair<int, int>>> ranges;
+        std::unordered_map<std::string, double> weights;
+        std::unordered_map<std::string, std::string> constants;  // 每个定义都是同一个LOAD_IMM的变量
+        for (const auto &block : func_->blocks)
         {
-            int start = -1;
-            int end = -1;
+            double weight = std::pow(10.0, std::min(block.loop_depth, 8));
+            std::unordered_map<std::string, int> live_end;  // 活跃变量 -> 范围结束位置
+            for (const auto &var : block.live_out)
+            {
+                if (is_variable(var))
+                    live_end[var] = block.end_idx;
+            }
 
-            // 寻找第一次和最后一次使用
-            for (int i = 0; i < (int)func_->instrs.size(); i++)
+            for (int i = block.end_idx; i >= block.start_idx; i--)
             {
-                const auto &instr = func_->instrs[i];
-
-                // 检查变量是否被使用
-                bool used = false;
-                if (!is_number(instr.src1) && instr.src1 == var)
-                    used = true;
-                if (!is_number(instr.src2) && instr.src2 == var)
-                    used = true;
-                if (instr.dest == var)
-                    used = true;
-
-                // 对于CALL，所有参数寄存器可能被修改
-                if (instr.op == TacOp::CALL)
+                const TacInstr &instr = func_->instrs[i];
+                if (instr_has_def(instr) && is_variable(instr.dest))
                 {
-                    // 检查是否是a0-a7
-                    if (var.length() == 2 && var[0] == 'a' && isdigit(var[1]))
-                    {
-                        int arg_idx = var[1] - '0';
-                        if (arg_idx >= 0 && arg_idx <= 7)
-                        {
-                            // a0-a7在调用后可能被修改
-                            if (instr.dest == var)
-                                used = true;
-                        }
-                    }
+                    auto it = live_end.find(instr.dest);
+                    int end = it != live_end.end() ? it->second : i;  // 无用的定义也要占一个位置
+                    ranges[instr.dest].push_back({i, end});
+                    weights[instr.dest] += weight;
+                    auto constant = constants.find(instr.dest);
+                    std::string value = instr.op == TacOp::LOAD_IMM ? instr.src1 : "";
+                    if (constant == constants.end())
+                        constants[instr.dest] = value;
+                    else if (constant->second != value)
+                        constant->second = "";
+                    if (it != live_end.end())
+                        live_end.erase(it);
                 }
-
-                if (used)
+                for (const std::string *slot : instr_use_slots(instr))
                 {
-                    if (start == -1)
-                        start = i;
-                    end = i;
+                    if (!is_variable(*slot))
+                        continue;
+                    weights[*slot] += weight;
+                    if (!live_end.count(*slot))
+                        live_end[*slot] = i;
                 }
             }
+            for (const auto &entry : live_end)
+            {
+                ranges[entry.first].push_back({block.start_idx, entry.second});
+            }
+        }
 
-            if (start != -1)
+        for (auto &entry : ranges)
+        {
+            auto &list = entry.second;
+            std::sort(list.begin(), list.end());
+
+            Interval interval;
+            interval.var = entry.first;
+            interval.reg = "";
+            interval.spill_offset = -1;
+            interval.is_user_var = is_user_var(entry.first);
+            interval.remat = constants[entry.first];
+            interval.weight = weights[entry.first];
+            // 合并相邻或重叠的范围
+            for (const auto &r : list)
             {
-                Interval interval;
-                interval.var = var;
-                interval.start = start;
-                interval.end = end;
-                interval.length = end - start;
-                interval.reg = "";
-                interval.spill_offset = -1;
-                interval.is_user_var = is_user_var(var);
-                intervals_.push_back(interval);
+                if (!interval.ranges.empty() && r.first <= interval.ranges.back().end + 1)
+                {
+                    interval.ranges.back().end = std::max(interval.ranges.back().end, r.second);
+                }
+                else
+                {
+                    interval.ranges.push_back({r.first, r.second, ""});
+                }
             }
+            interval.start = interval.ranges.front().start;
+            interval.end = interval.ranges.back().end;
+            interval.length = interval.end - interval.start;
+            intervals_.push_back(interval);
         }
 
-        // 按开始位置排序（线性扫描的标准做法）
+        // 按溢出代价从高到低分配：循环中频繁使用的值先挑寄存器。
+        // 寄存器的占用按范围记录，分配顺序不必按开始位置
         std::sort(intervals_.begin(), intervals_.end(),
                   [](const Interval &a, const Interval &b)
                   {
-                      return a.start < b.start;
+                      if (a.weight != b.weight)
+                          return a.weight > b.weight;
+                      if (a.start != b.start)
+                          return a.start < b.start;
+                      return a.var < b.var;
                   });
     }
 
-    // 线性扫描寄存器分配 - 寄存器优先版本
-    // 核心原则：所有变量默认分配到寄存器，只有在寄存器不够时才溢出
-    void linear_scan()
+    // 收集可以在边界拆分的循环：循环头前紧挨着唯一的前置块，且循环头是循环中最早的块
+    void compute_loops()
     {
-        active_.clear();
-        std::vector<bool> reg_used_(available_regs_.size(), false);
-        int next_spill_offset = 4; // 从4开始（0位置留给ra）
-
-        // 按活跃范围排序（线性扫描的标准做法）
-        std::sort(intervals_.begin(), intervals_.end(),
-                  [](const Interval &a, const Interval &b)
-                  {
-                      return a.start < b.start;
-                  });
-
-        for (size_t i = 0; i < intervals_.size(); i++)
+        loops_.clear();
+        for (const auto &loop : func_->natural_loops())
         {
-            Interval &interval = intervals_[i];
-
-            // 1. 从活动集中移除已过期的区间
-            std::set<size_t> to_remove;
-            for (size_t idx : active_)
+            const BasicBlock &header = func_->blocks[loop.first];
+            int preheader = -1;
+            int outside = 0;
+            for (const auto &pred_name : header.predecessors)
             {
-                // 如果区间结束 < 当前区间开始，则该寄存器可以释放
-                if (intervals_[idx].end < interval.start)
+                int p = func_->block_index[pred_name];
+                if (!loop.second.count(p))
                 {
-                    // 释放寄存器
-                    for (size_t r = 0; r < available_regs_.size(); r++)
-                    {
-                        if (available_regs_[r].name == intervals_[idx].reg)
-                        {
-                            reg_used_[r] = false;
-                            break;
-                        }
-                    }
-                    to_remove.insert(idx);
+                    preheader = p;
+                    outside++;
                 }
             }
-            for (size_t idx : to_remove)
+            if (outside != 1 || func_->blocks[preheader].end_idx + 1 != header.start_idx)
+                continue;
+
+            LoopSpan span;
+            span.body = loop.second;
+            span.lo = header.start_idx - 1;
+            span.hi = header.end_idx;
+            span.depth = header.loop_depth;
+            bool header_first = true;
+            for (int b : loop.second)
             {
-                active_.erase(idx);
+                header_first = header_first && func_->blocks[b].start_idx >= header.start_idx;
+                span.hi = std::max(span.hi, func_->blocks[b].end_idx);
             }
+            if (header_first)
+                loops_.push_back(span);
+        }
+        std::sort(loops_.begin(), loops_.end(),
+                  [](const LoopSpan &a, const LoopSpan &b)
+                  {
+                      if (a.depth != b.depth)
+                          return a.depth < b.depth;
+                      return a.lo < b.lo;
+                  });
+    }
 
-            // 2. 尝试分配寄存器（总是优先使用寄存器）
-            int reg_idx = -1;
-
-            // 查找空闲寄存器
-            for (size_t r = 0; r < available_regs_.size(); r++)
+    // 收集寄存器提示，使传参、取参、返回值和调用结果的复制成为 addi x, x, 0
+    // 被窥孔删掉：
+    //   PARAM aN, v / LOAD_PARAM v, aN     v 提示 aN
+    //   MOVE a0, v / CALL v, f             v 提示 a0
+    //   MOVE x, y（以及LOAD/STORE复制）    x、y 互相提示对方的寄存器
+    void compute_hints()
+    {
+        reg_hints_.clear();
+        copy_partners_.clear();
+        for (const auto &instr : func_->instrs)
+        {
+            switch (instr.op)
             {
-                if (!reg_used_[r])
-                {
-                    reg_idx = r;
+            case TacOp::PARAM:
+                if (is_variable(instr.src1))
+                    reg_hints_[instr.src1].push_back(instr.dest);
+                break;
+            case TacOp::LOAD_PARAM:
+                reg_hints_[instr.dest].push_back(instr.src1);
+                break;
+            case TacOp::CALL:
+                if (!instr.dest.empty())
+                    reg_hints_[instr.dest].push_back("a0");
+                break;
+            case TacOp::MOVE:
+            case TacOp::LOAD:
+            case TacOp::STORE:
+                if (!is_variable(instr.src1))
                     break;
+                if (!is_variable(instr.dest))
+                {
+                    reg_hints_[instr.src1].push_back(instr.dest);
                 }
+                else
+                {
+                    copy_partners_[instr.dest].push_back(instr.src1);
+                    copy_partners_[instr.src1].push_back(instr.dest);
+                }
+                break;
+            default:
+                break;
             }
+        }
+    }
 
-            if (reg_idx != -1)
+    std::vector<std::string> hints_for(const std::string &var) const
+    {
+        std::vector<std::string> hints;
+        auto it = reg_hints_.find(var);
+        if (it != reg_hints_.end())
+            hints = it->second;
+        auto partners = copy_partners_.find(var);
+        if (partners != copy_partners_.end())
+        {
+            for (const auto &other : partners->second)
             {
-                // 分配寄存器
-                interval.reg = available_regs_[reg_idx].name;
-                reg_used_[reg_idx] = true;
-                active_.insert(i);
+                auto reg = assigned_.find(other);
+                if (reg != assigned_.end())
+                    hints.push_back(reg->second);
             }
-            else
-            {
-                // 所有寄存器都被占用，必须选择一个变量溢出
-                // 溢出策略：优先溢出临时变量，保留用户变量在寄存器中
+        }
+        return hints;
+    }
 
-                int spill_idx = -1;
-                int best_score = INT_MIN;
+    // 寄存器r在[start, end]内是否空闲（其他区间的空洞可以复用）
+    bool reg_free(size_t r, int start, int end) const
+    {
+        for (const auto &occupied : reg_occupied_[r])
+        {
+            if (occupied.first <= end && start <= occupied.second)
+                return false;
+        }
+        return true;
+    }
 
-                for (size_t idx : active_)
-                {
-                    const auto &active_interval = intervals_[idx];
+    // 范围内是否有CALL：值在调用前定义、调用后仍被使用
+    bool crosses_call(const LiveRange &range) const
+    {
+        auto it = std::upper_bound(call_sites_.begin(), call_sites_.end(), range.start);
+        return it != call_sites_.end() && *it < range.end;
+    }
 
-                    // 计算溢出分数（分数越高越应该被溢出）
-                    int score = 0;
+    // 跨越CALL的值优先使用被调用者保存寄存器（只在序言/尾声中保存一次），
+    // 其余的值优先使用调用者保存寄存器（完全不用保存）。
+    // CALL会改写a0-a7（调用处的clobber区间），跨越CALL的值不能放在参数寄存器中。
+    // 跨越CALL的值放进调用者保存寄存器时，每次调用前后要各存取一次；
+    // 这比溢出代价weight还高时宁可不分配寄存器
+    // 提示的寄存器最先尝试
+    int find_free_reg(const std::vector<LiveRange> &ranges,
+                      const std::vector<std::string> &hints = {},
+                      double weight = HUGE_VAL) const
+    {
+        bool crosses = false;
+        double save_cost = 0;
+        for (const auto &range : ranges)
+        {
+            crosses = crosses || crosses_call(range);
+            auto it = std::upper_bound(call_sites_.begin(), call_sites_.end(), range.start);
+            for (; it != call_sites_.end() && *it < range.end; ++it)
+                save_cost += 2 * call_weights_[it - call_sites_.begin()];
+        }
 
-                    // 临时变量优先溢出（+100分）
-                    if (!active_interval.is_user_var)
-                        score += 100;
+        auto fits = [&](size_t r)
+        {
+            if (crosses && available_regs_[r].category == RegCategory::ARG)
+                return false;
+            if (crosses && available_regs_[r].caller_save && save_cost > weight)
+                return false;
+            for (const auto &range : ranges)
+            {
+                if (!reg_free(r, range.start, range.end))
+                    return false;
+            }
+            return true;
+        };
 
-                    // 用户变量尽量保留（-200分）
-                    if (active_interval.is_user_var)
-                        score -= 200;
+        for (const auto &hint : hints)
+        {
+            int r = allocatable_index(hint);
+            if (r >= 0 && fits(r))
+                return r;
+        }
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (size_t r = 0; r < available_regs_.size(); r++)
+            {
+                bool preferred = available_regs_[r].caller_save != crosses;
+                if (preferred == (pass == 0) && fits(r))
+                    return r;
+            }
+        }
+        return -1;
+    }
 
-                    // 活跃范围越短，越优先溢出（短生命期变量溢出代价更低）
-                    int live_range = active_interval.end - active_interval.start;
-                    score += live_range / 10;
+    // Second-chance binpacking 线性扫描
+    // 1. 区间整体（包括空洞）能放进某个寄存器就整体分配，其他区间可以使用它的空洞
+    // 2. 否则区间在空洞处拆开，每一段再单独找寄存器（第二次机会），找不到的段留在栈上。
+    //    拆开的变量有固定栈槽：每次定义都写回栈槽，在块入口重新进入寄存器时从栈槽装载
+    // 参数寄存器的固定区间：函数入口到 LOAD_PARAM x, aN 之前，aN 保存着传入的参数。
+    // 传出的参数由代码生成器在CALL前作为一次并行复制放入a0-a7，不需要固定区间；
+    // CALL的结果在a0中，CALL的目标可以直接分配到a0
+    void reserve_argument_registers()
+    {
+        auto reserve = [&](const std::string &reg, int start, int end)
+        {
+            int r = allocatable_index(reg);
+            if (r >= 0 && start <= end)
+                reg_occupied_[r].push_back({start, end});
+        };
+        int n = func_->instrs.size();
+        for (int i = 0; i < n; i++)
+        {
+            const TacInstr &instr = func_->instrs[i];
+            if (instr.op == TacOp::LOAD_PARAM)
+                reserve(instr.src1, 0, i - 1);
+        }
+    }
 
-                    // 已经溢出过的变量再次溢出代价较低（+20分）
-                    if (active_interval.spill_offset >= 0)
-                        score += 20;
+    // 指令i定义var且不读取它：段从这里开始时不需要从栈槽装载
+    bool pure_def(int i, const std::string &var) const
+    {
+        const TacInstr &instr = func_->instrs[i];
+        if (!instr_has_def(instr) || instr.dest != var)
+            return false;
+        for (const std::string *slot : instr_use_slots(instr))
+        {
+            if (*slot == var)
+                return false;
+        }
+        return true;
+    }
 
-                    // 选择分数最高的（最应该被溢出的）
-                    if (score > best_score)
+    // 整段放不进寄存器时，只把其中的循环放进寄存器（外层循环优先，放不下再试内层）：
+    // 值在前置块末尾装入寄存器。循环的出口只有紧跟在循环后面的一个块时，
+    // 循环中的定义不写回栈槽，改为在出口块入口写回一次；其余情况仍然每次定义都写回。
+    // 循环之外的部分留在栈上
+    std::vector<LiveRange> split_at_loops(const Interval &interval, const LiveRange &range,
+                                          const std::vector<std::string> &hints)
+    {
+        const std::string &var = interval.var;
+        std::vector<LiveRange> segments;
+        for (const auto &loop : loops_)
+        {
+            LiveRange segment{std::max(range.start, loop.lo), std::min(range.end, loop.hi), ""};
+            if (segment.start > segment.end)
+                continue;
+            // 循环中的活跃部分必须都在这一段里（空洞另一侧的部分可能沿回边流回来）
+            bool overlaps = false;
+            for (const auto &other : interval.ranges)
+            {
+                if (other.start != range.start && other.start <= loop.hi + 1 && loop.lo <= other.end)
+                    overlaps = true;
+            }
+            for (const auto &other : segments)
+                overlaps = overlaps || (other.start <= segment.end + 1 && segment.start <= other.end + 1);
+            if (overlaps)
+                continue;
+
+            // 循环中要用到这个值；夹在循环中的其他块（例如循环中的return）里它必须是死的
+            bool used = false;
+            bool foreign = false;
+            std::vector<int> exits;
+            for (size_t b = 0; b < func_->blocks.size(); b++)
+            {
+                const BasicBlock &block = func_->blocks[b];
+                bool in_loop = loop.body.count(b);
+                bool touches = block.live_in.count(var) > 0;
+                for (int i = block.start_idx; i <= block.end_idx; i++)
+                {
+                    const TacInstr &instr = func_->instrs[i];
+                    touches = touches || (instr_has_def(instr) && instr.dest == var);
+                    for (const std::string *slot : instr_use_slots(instr))
+                        touches = touches || *slot == var;
+                }
+                if (in_loop)
+                {
+                    used = used || touches;
+                    continue;
+                }
+                if (block.start_idx > loop.lo && block.start_idx <= loop.hi && touches)
+                    foreign = true;
+                if (!block.live_in.count(var))
+                    continue;
+                for (const auto &pred_name : block.predecessors)
+                {
+                    if (loop.body.count(func_->block_index[pred_name]))
                     {
-                        best_score = score;
-                        spill_idx = idx;
+                        exits.push_back(b);
+                        break;
                     }
                 }
+            }
+            if (!used || foreign)
+                continue;
 
-                if (spill_idx >= 0)
+            if (exits.empty())
+            {
+                segment.write_through = false;
+            }
+            else if (exits.size() == 1 && func_->blocks[exits[0]].start_idx == loop.hi + 1)
+            {
+                const BasicBlock &exit = func_->blocks[exits[0]];
+                bool dedicated = true;
+                for (const auto &pred_name : exit.predecessors)
+                    dedicated = dedicated && loop.body.count(func_->block_index[pred_name]);
+                if (dedicated && range.end > loop.hi)
                 {
-                    // 溢出选中的变量
-                    intervals_[spill_idx].spill_offset = next_spill_offset;
-                    next_spill_offset += 4;
+                    segment.end = loop.hi + 1;
+                    segment.write_through = false;
+                    segment.write_back = true;
+                }
+            }
 
-                    // 释放其寄存器
-                    for (size_t r = 0; r < available_regs_.size(); r++)
-                    {
-                        if (available_regs_[r].name == intervals_[spill_idx].reg)
-                        {
-                            reg_used_[r] = false;
-                            break;
-                        }
-                    }
+            int r = find_free_reg({segment}, hints, interval.weight);
+            if (r == -1)
+                continue;
+            segment.reg = available_regs_[r].name;
+            reg_occupied_[r].push_back({segment.start, segment.end});
+            segments.push_back(segment);
+        }
+
+        // 循环之间和前后的部分留在栈上
+        std::sort(segments.begin(), segments.end(),
+                  [](const LiveRange &a, const LiveRange &b) { return a.start < b.start; });
+        std::vector<LiveRange> pieces;
+        int next = range.start;
+        for (const auto &segment : segments)
+        {
+            if (segment.start > next)
+                pieces.push_back({next, segment.start - 1, ""});
+            pieces.push_back(segment);
+            next = segment.end + 1;
+        }
+        if (next <= range.end)
+            pieces.push_back({next, range.end, ""});
+        return pieces;
+    }
+
+    // 栈槽着色：生存期不重叠的变量共用栈槽，溢出区的大小取决于同时溢出的变量数。
+    // 变量在整个区间（不含空洞）上占用栈槽，包括在寄存器中的段：
+    // 定义时写回栈槽，段进入寄存器或离开循环时也要经过栈槽
+    // 返回溢出区内的偏移，由代码生成器放进栈帧
+    int assign_spill_slot(const std::vector<LiveRange> &ranges)
+    {
+        size_t slot = 0;
+        for (; slot < slot_occupied_.size(); slot++)
+        {
+            bool free = true;
+            for (const auto &occupied : slot_occupied_[slot])
+            {
+                for (const auto &range : ranges)
+                    free = free && (occupied.first > range.end || range.start > occupied.second);
+            }
+            if (free)
+                break;
+        }
+        if (slot == slot_occupied_.size())
+            slot_occupied_.emplace_back();
+        for (const auto &range : ranges)
+            slot_occupied_[slot].push_back({range.start, range.end});
+        return slot * 4;
+    }
 
-                    // 将释放的寄存器分配给当前变量
-                    interval.reg = intervals_[spill_idx].reg;
-                    reg_used_[allocatable_index(interval.reg)] = true;
-                    active_.insert(i);
+    void linear_scan()
+    {
+        reg_occupied_.assign(available_regs_.size(), {});
+        reserve_argument_registers();
+        compute_hints();
+        assigned_.clear();
+        slot_occupied_.clear();
+
+        for (auto &interval : intervals_)
+        {
+            std::vector<std::string> hints = hints_for(interval.var);
+            int reg_idx = find_free_reg(interval.ranges, hints, interval.weight);
+            if (reg_idx != -1)
+            {
+                interval.reg = available_regs_[reg_idx].name;
+                assigned_[interval.var] = interval.reg;
+                for (auto &range : interval.ranges)
+                {
+                    range.reg = interval.reg;
+                    reg_occupied_[reg_idx].push_back({range.start, range.end});
                 }
-                else
+                continue;
+            }
+
+            // 常量不需要栈槽：不在寄存器中的部分在使用处重新li，
+            // 拆开的段在进入寄存器时也是li而不是从栈槽装载
+            if (interval.remat.empty())
+                interval.spill_offset = assign_spill_slot(interval.ranges);
+            std::vector<LiveRange> split;
+            for (auto &range : interval.ranges)
+            {
+                int r = find_free_reg({range}, hints, interval.weight);
+                if (r == -1)
                 {
-                    // 极端情况：当前变量必须溢出
-                    interval.spill_offset = next_spill_offset;
-                    next_spill_offset += 4;
+                    std::vector<LiveRange> pieces = split_at_loops(interval, range, hints);
+                    split.insert(split.end(), pieces.begin(), pieces.end());
+                    continue;
                 }
+                range.reg = available_regs_[r].name;
+                reg_occupied_[r].push_back({range.start, range.end});
+                split.push_back(range);
             }
+            interval.ranges = std::move(split);
         }
 
         // 构建每条指令的分配信息
-        for (int i = 0; i < (int)func_->instrs.size(); i++)
+        for (const auto &interval : intervals_)
         {
-            for (const auto &interval : intervals_)
+            for (const auto &range : interval.ranges)
             {
-                if (i >= interval.start && i <= interval.end)
+                for (int i = range.start; i <= range.end; i++)
                 {
                     // 只有在有寄存器分配时才添加到reg_map
-                    if (!interval.reg.empty())
-                    {
-                        allocation_[i].reg_map[interval.var] = interval.reg;
-                    }
-                    // 只有在有溢出偏移时才添加到spill_offset
-                    if (interval.spill_offset >= 0)
-                    {
+                    if (!range.reg.empty())
+                        allocation_[i].reg_map[interval.var] = range.reg;
+                    if (!interval.remat.empty() && interval.reg.empty())
+                        allocation_[i].remat[interval.var] = interval.remat;
+                    // 有栈槽的变量（溢出或拆分）定义时写回栈槽；循环中的段只在两端用到栈槽
+                    if (interval.spill_offset < 0)
+                        continue;
+                    if (range.write_through || (i == range.start && !pure_def(i, interval.var)) ||
+                        (i == range.end && range.write_back))
                         allocation_[i].spill_offset[interval.var] = interval.spill_offset;
+                }
+                if (range.write_back && interval.spill_offset >= 0)
+                    allocation_[range.end].write_back.push_back(interval.var);
+            }
+        }
+
+        // 仍然放在调用者保存寄存器中跨越CALL的值，由代码生成器在调用前后保存恢复
+        for (const auto &interval : intervals_)
+        {
+            for (const auto &range : interval.ranges)
+            {
+                if (range.reg.empty() || !crosses_call(range) || reg_is_callee_saved(range.reg))
+                    continue;
+                auto it = std::upper_bound(call_sites_.begin(), call_sites_.end(), range.start);
+                for (; it != call_sites_.end() && *it < range.end; ++it)
+                    allocation_[*it].caller_saved.push_back(range.reg);
+            }
+        }
+
+        for (const auto &interval : intervals_)
+        {
+            for (const auto &range : interval.ranges)
+            {
+                // 拆分后的段在块入口进入寄存器时需要从栈槽装载，
+                // 除非所有前驱结束时它已经在同一个寄存器中
+                if (range.reg.empty() || interval.reg == range.reg)
+                    continue;
+                // 在块中间开始的段（循环的前置块末尾）
+                bool block_start = false;
+                for (const auto &block : func_->blocks)
+                    block_start = block_start || block.start_idx == range.start;
+                if (!block_start && !pure_def(range.start, interval.var))
+                    allocation_[range.start].reload.push_back(interval.var);
+                for (size_t b = 1; b < func_->blocks.size(); b++)
+                {
+                    const BasicBlock &block = func_->blocks[b];
+                    if (block.start_idx < range.start || block.start_idx > range.end ||
+                        !block.live_in.count(interval.var))
+                        continue;
+                    bool same_reg = true;
+                    for (const auto &pred_name : block.predecessors)
+                    {
+                        int pred_end = func_->blocks[func_->block_index[pred_name]].end_idx;
+                        const auto &pred_map = allocation_[pred_end].reg_map;
+                        auto it = pred_map.find(interval.var);
+                        if (it == pred_map.end() || it->second != range.reg)
+                        {
+                            same_reg = false;
+                            break;
+                        }
                     }
+                    if (!same_reg)
+                        allocation_[block.start_idx].reload.push_back(interval.var);
                 }
             }
         }
     }
 
+    bool reg_is_callee_saved(const std::string &reg_name) const
+    {
+        for (const auto &r : available_regs_)
+        {
+            if (r.name == reg_name)
+                return !r.caller_save;
+        }
+        return false;
+    }
+
     // 辅助函数：根据寄存器名获取其在available_regs_中的索引
-    int allocatable_index(const std::string &reg_name)
+    int allocatable_index(const std::string &reg_name) const
     {
         for (size_t r = 0; r < available_regs_.size(); r++)
         {
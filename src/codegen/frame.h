@@ -0,0 +1,64 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <string>
+#include <vector>
+#include <set>
+
+// Stack frame of one function, laid out after register allocation.
+//
+//     incoming stack arguments   <- sp on entry (arguments 8 and up)
+//     ra                         only if the function makes calls
+//     saved s-registers          only those the allocator handed out
+//     padding                    keeps sp 16-byte aligned (RV32 ABI)
+//     caller-saved registers     stored around a call they are live across
+//     spill slots                <- sp
+//
+// ToyC frames have a fixed size, so everything is addressed from sp and no
+// frame pointer is kept: s0 is an ordinary callee-saved register. A leaf
+// function that spills nothing and uses no s-register has no frame at all.
+struct FrameLayout
+{
+    int size = 0;          // Bytes reserved below the entry sp
+    int ra_offset = -1;    // sp offset of the saved ra, -1 in leaf functions
+    int spill_base = 0;    // sp offset of the spill area
+    int caller_save_base = 0;  // sp offset of the caller-saved register area
+    std::vector<std::pair<std::string, int>> saved_regs;  // s-register -> sp offset
+
+    void compute(bool has_calls, const std::set<std::string> &used_regs, int spill_bytes,
+                 int caller_save_bytes)
+    {
+        static const char *callee_saved[] = {"s0", "s1", "s2", "s3", "s4", "s5",
+                                              "s6", "s7", "s8", "s9", "s10", "s11"};
+        int saved = 0;
+        for (const char *reg : callee_saved)
+            saved += used_regs.count(reg);
+        size = (spill_bytes + caller_save_bytes + 4 * saved + (has_calls ? 4 : 0) + 15) / 16 * 16;
+        spill_base = 0;
+        caller_save_base = spill_bytes;
+
+        int top = size;
+        ra_offset = -1;
+        if (has_calls)
+        {
+            top -= 4;
+            ra_offset = top;
+        }
+        saved_regs.clear();
+        for (const char *reg : callee_saved)
+        {
+            if (!used_regs.count(reg))
+                continue;
+            top -= 4;
+            saved_regs.push_back({reg, top});
+        }
+    }
+
+    // sp offset of an incoming stack argument ("#s0:<offset>" in the TAC)
+    int incoming_arg(int offset) const
+    {
+        return size + offset;
+    }
+};
+
+#endif // FRAME_H
@@ -0,0 +1,571 @@
+#ifndef GRAPH_ALLOCATOR_H
+#define GRAPH_ALLOCATOR_H
+
+#include "ir/tac.h"
+#include "ir/cfg.h"
+#include "codegen/allocator.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+
+// Graph-coloring register allocator: iterated register coalescing
+// (George & Appel) on top of Chaitin-Briggs optimistic coloring.
+//
+// 干涉图由 FunctionIR::compute_liveness 的块活跃信息逐条指令倒推得到。
+// 复制指令（MOVE，以及本后端中等同于寄存器复制的 LOAD/STORE）按 Briggs
+// 保守条件合并。无法着色的节点整段住在栈槽里，由代码生成器用 t0/t1 重新
+// 装载，因此不需要重写程序再迭代。跨越 CALL 仍然活跃的值只能分配被调用者
+// 保存寄存器。溢出代价按 10^循环深度 加权。
+//
+// 结果以与 LinearScanAllocator 相同的 InstrAlloc 形式给出。
+class GraphColoringAllocator
+{
+public:
+    GraphColoringAllocator(FunctionIR *func)
+        : func_(func)
+    {
+        // 与线性扫描相同的寄存器集合：排除 a0-a7 和 t0/t1（代码生成的临时寄存器）
+        // 调用者保存寄存器在前，不跨调用的值优先使用它们
+        colors_ = {"t2", "t3", "t4", "t5", "t6",
+                   "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11"};
+        num_caller_saved_ = 5;
+    }
+
+    void allocate()
+    {
+        allocation_.clear();
+        allocation_.resize(func_->instrs.size());
+        if (func_->instrs.empty())
+            return;
+
+        build();
+        make_worklist();
+        while (true)
+        {
+            if (!simplify_worklist_.empty())
+                simplify();
+            else if (!worklist_moves_.empty())
+                coalesce();
+            else if (!freeze_worklist_.empty())
+                freeze();
+            else if (!spill_worklist_.empty())
+                select_spill();
+            else
+                break;
+        }
+        assign_colors();
+        record_allocation();
+    }
+
+    const InstrAlloc &get_allocation(int idx) const
+    {
+        return allocation_[idx];
+    }
+
+    int get_spill_count() const
+    {
+        return spill_count_;
+    }
+
+private:
+    FunctionIR *func_;
+    std::vector<InstrAlloc> allocation_;
+    std::vector<std::string> colors_;
+    int num_caller_saved_;
+    int spill_count_ = 0;
+
+    enum class NodeState
+    {
+        Initial,
+        Simplify,
+        Freeze,
+        Spill,
+        Coalesced,
+        Colored,
+        Spilled,
+        Selected
+    };
+
+    enum class MoveState
+    {
+        Worklist,
+        Active,
+        Coalesced,
+        Constrained,
+        Frozen
+    };
+
+    // Nodes
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, int> node_index_;
+    std::vector<NodeState> state_;
+    std::vector<std::vector<int>> adj_list_;
+    std::unordered_set<long long> adj_set_;
+    std::vector<int> degree_;
+    std::vector<int> alias_;
+    std::vector<int> color_;        // index into colors_, -1 if none
+    std::vector<bool> crosses_call_;
+    std::vector<double> spill_cost_;
+    std::vector<std::vector<int>> move_list_;
+
+    // Moves
+    std::vector<std::pair<int, int>> moves_;  // (dest, src)
+    std::vector<MoveState> move_state_;
+
+    // Worklists
+    std::vector<int> simplify_worklist_;
+    std::vector<int> freeze_worklist_;
+    std::vector<int> spill_worklist_;
+    std::vector<int> worklist_moves_;
+    std::vector<int> select_stack_;
+
+    int K() const
+    {
+        return (int)colors_.size();
+    }
+
+    int node(const std::string &var)
+    {
+        auto it = node_index_.find(var);
+        if (it != node_index_.end())
+            return it->second;
+        int n = (int)names_.size();
+        names_.push_back(var);
+        node_index_[var] = n;
+        state_.push_back(NodeState::Initial);
+        adj_list_.emplace_back();
+        degree_.push_back(0);
+        alias_.push_back(n);
+        color_.push_back(-1);
+        crosses_call_.push_back(false);
+        spill_cost_.push_back(0.0);
+        move_list_.emplace_back();
+        return n;
+    }
+
+    static long long edge_key(int u, int v)
+    {
+        return ((long long)u << 32) | (unsigned int)v;
+    }
+
+    bool adjacent(int u, int v) const
+    {
+        return adj_set_.count(edge_key(u, v)) > 0;
+    }
+
+    void add_edge(int u, int v)
+    {
+        if (u == v || adjacent(u, v))
+            return;
+        adj_set_.insert(edge_key(u, v));
+        adj_set_.insert(edge_key(v, u));
+        adj_list_[u].push_back(v);
+        adj_list_[v].push_back(u);
+        degree_[u]++;
+        degree_[v]++;
+    }
+
+    static bool is_move(const TacInstr &instr)
+    {
+        if (instr.op != TacOp::MOVE && instr.op != TacOp::LOAD && instr.op != TacOp::STORE)
+            return false;
+        return is_variable(instr.dest) && is_variable(instr.src1);
+    }
+
+    // 构建干涉图：从块出口活跃集合倒序扫描每条指令
+    void build()
+    {
+        func_->build_cfg();
+        func_->compute_liveness();
+        func_->compute_dominators();
+        func_->compute_loop_depths();
+
+        for (const auto &block : func_->blocks)
+        {
+            double weight = std::pow(10.0, std::min(block.loop_depth, 8));
+            std::unordered_set<int> live;
+            for (const auto &v : block.live_out)
+            {
+                if (is_variable(v))
+                    live.insert(node(v));
+            }
+
+            for (auto it = block.instrs.rbegin(); it != block.instrs.rend(); ++it)
+            {
+                const TacInstr &instr = *it;
+                if (instr.op == TacOp::LABEL)
+                    continue;
+
+                bool has_def = instr_has_def(instr) && is_variable(instr.dest);
+                int def = has_def ? node(instr.dest) : -1;
+
+                if (instr.op == TacOp::CALL)
+                {
+                    // 调用之后仍然活跃的值会被调用者保存寄存器破坏
+                    for (int v : live)
+                    {
+                        if (v != def)
+                            crosses_call_[v] = true;
+                    }
+                }
+
+                int move_src = -1;
+                if (is_move(instr))
+                {
+                    move_src = node(instr.src1);
+                    int m = (int)moves_.size();
+                    moves_.push_back({def, move_src});
+                    move_state_.push_back(MoveState::Worklist);
+                    move_list_[def].push_back(m);
+                    move_list_[move_src].push_back(m);
+                }
+
+                if (has_def)
+                {
+                    for (int v : live)
+                    {
+                        if (v != move_src)
+                            add_edge(def, v);
+                    }
+                    live.erase(def);
+                    spill_cost_[def] += weight;
+                }
+
+                for (const std::string *slot : instr_use_slots(instr))
+                {
+                    if (!is_variable(*slot))
+                        continue;
+                    int u = node(*slot);
+                    live.insert(u);
+                    spill_cost_[u] += weight;
+                }
+            }
+        }
+    }
+
+    std::vector<int> node_moves(int n) const
+    {
+        std::vector<int> result;
+        for (int m : move_list_[n])
+        {
+            if (move_state_[m] == MoveState::Worklist || move_state_[m] == MoveState::Active)
+                result.push_back(m);
+        }
+        return result;
+    }
+
+    bool move_related(int n) const
+    {
+        return !node_moves(n).empty();
+    }
+
+    // Neighbours still in the graph
+    std::vector<int> adjacent_nodes(int n) const
+    {
+        std::vector<int> result;
+        for (int v : adj_list_[n])
+        {
+            if (state_[v] != NodeState::Selected && state_[v] != NodeState::Coalesced)
+                result.push_back(v);
+        }
+        return result;
+    }
+
+    void make_worklist()
+    {
+        for (int m = 0; m < (int)moves_.size(); m++)
+            worklist_moves_.push_back(m);
+
+        for (int n = 0; n < (int)names_.size(); n++)
+        {
+            if (degree_[n] >= K())
+            {
+                state_[n] = NodeState::Spill;
+                spill_worklist_.push_back(n);
+            }
+            else if (move_related(n))
+            {
+                state_[n] = NodeState::Freeze;
+                freeze_worklist_.push_back(n);
+            }
+            else
+            {
+                state_[n] = NodeState::Simplify;
+                simplify_worklist_.push_back(n);
+            }
+        }
+    }
+
+    static void remove_from(std::vector<int> &list, int n)
+    {
+        auto it = std::find(list.begin(), list.end(), n);
+        if (it != list.end())
+            list.erase(it);
+    }
+
+    void simplify()
+    {
+        int n = simplify_worklist_.back();
+        simplify_worklist_.pop_back();
+        state_[n] = NodeState::Selected;
+        select_stack_.push_back(n);
+        for (int m : adjacent_nodes(n))
+            decrement_degree(m);
+    }
+
+    void decrement_degree(int m)
+    {
+        int d = degree_[m]--;
+        if (d != K() || state_[m] != NodeState::Spill)
+            return;
+
+        enable_moves(m);
+        for (int n : adjacent_nodes(m))
+            enable_moves(n);
+        remove_from(spill_worklist_, m);
+        if (move_related(m))
+        {
+            state_[m] = NodeState::Freeze;
+            freeze_worklist_.push_back(m);
+        }
+        else
+        {
+            state_[m] = NodeState::Simplify;
+            simplify_worklist_.push_back(m);
+        }
+    }
+
+    void enable_moves(int n)
+    {
+        for (int m : node_moves(n))
+        {
+            if (move_state_[m] == MoveState::Active)
+            {
+                move_state_[m] = MoveState::Worklist;
+                worklist_moves_.push_back(m);
+            }
+        }
+    }
+
+    int get_alias(int n) const
+    {
+        while (state_[n] == NodeState::Coalesced)
+            n = alias_[n];
+        return n;
+    }
+
+    void add_worklist(int u)
+    {
+        if (state_[u] == NodeState::Freeze && !move_related(u) && degree_[u] < K())
+        {
+            remove_from(freeze_worklist_, u);
+            state_[u] = NodeState::Simplify;
+            simplify_worklist_.push_back(u);
+        }
+    }
+
+    // Briggs: the merged node has fewer than K neighbours of significant degree
+    bool conservative(int u, int v) const
+    {
+        std::unordered_set<int> nodes;
+        for (int n : adjacent_nodes(u))
+            nodes.insert(n);
+        for (int n : adjacent_nodes(v))
+            nodes.insert(n);
+        int k = 0;
+        for (int n : nodes)
+        {
+            if (degree_[n] >= K())
+                k++;
+        }
+        return k < K();
+    }
+
+    void coalesce()
+    {
+        int m = worklist_moves_.back();
+        worklist_moves_.pop_back();
+        int u = get_alias(moves_[m].first);
+        int v = get_alias(moves_[m].second);
+
+        if (u == v)
+        {
+            move_state_[m] = MoveState::Coalesced;
+            add_worklist(u);
+        }
+        else if (adjacent(u, v))
+        {
+            move_state_[m] = MoveState::Constrained;
+            add_worklist(u);
+            add_worklist(v);
+        }
+        else if (conservative(u, v))
+        {
+            move_state_[m] = MoveState::Coalesced;
+            combine(u, v);
+            add_worklist(u);
+        }
+        else
+        {
+            move_state_[m] = MoveState::Active;
+        }
+    }
+
+    void combine(int u, int v)
+    {
+        if (state_[v] == NodeState::Freeze)
+            remove_from(freeze_worklist_, v);
+        else
+            remove_from(spill_worklist_, v);
+        state_[v] = NodeState::Coalesced;
+        alias_[v] = u;
+        move_list_[u].insert(move_list_[u].end(), move_list_[v].begin(), move_list_[v].end());
+        crosses_call_[u] = crosses_call_[u] || crosses_call_[v];
+        spill_cost_[u] += spill_cost_[v];
+        enable_moves(v);
+
+        for (int t : adjacent_nodes(v))
+        {
+            add_edge(t, u);
+            decrement_degree(t);
+        }
+        if (degree_[u] >= K() && state_[u] == NodeState::Freeze)
+        {
+            remove_from(freeze_worklist_, u);
+            state_[u] = NodeState::Spill;
+            spill_worklist_.push_back(u);
+        }
+    }
+
+    void freeze()
+    {
+        int u = freeze_worklist_.back();
+        freeze_worklist_.pop_back();
+        state_[u] = NodeState::Simplify;
+        simplify_worklist_.push_back(u);
+        freeze_moves(u);
+    }
+
+    void freeze_moves(int u)
+    {
+        for (int m : node_moves(u))
+        {
+            int x = moves_[m].first;
+            int y = moves_[m].second;
+            int v = get_alias(y) == get_alias(u) ? get_alias(x) : get_alias(y);
+            move_state_[m] = MoveState::Frozen;
+            if (state_[v] == NodeState::Freeze && !move_related(v) && degree_[v] < K())
+            {
+                remove_from(freeze_worklist_, v);
+                state_[v] = NodeState::Simplify;
+                simplify_worklist_.push_back(v);
+            }
+        }
+    }
+
+    // 选择 溢出代价/度数 最小的节点作为潜在溢出
+    void select_spill()
+    {
+        int best = -1;
+        double best_score = 0.0;
+        for (int n : spill_worklist_)
+        {
+            double score = spill_cost_[n] / std::max(degree_[n], 1);
+            if (best == -1 || score < best_score)
+            {
+                best = n;
+                best_score = score;
+            }
+        }
+        remove_from(spill_worklist_, best);
+        state_[best] = NodeState::Simplify;
+        simplify_worklist_.push_back(best);
+        freeze_moves(best);
+    }
+
+    void assign_colors()
+    {
+        while (!select_stack_.empty())
+        {
+            int n = select_stack_.back();
+            select_stack_.pop_back();
+
+            std::vector<bool> used(colors_.size(), false);
+            for (int w : adj_list_[n])
+            {
+                int a = get_alias(w);
+                if (state_[a] == NodeState::Colored)
+                    used[color_[a]] = true;
+            }
+            int first = crosses_call_[n] ? num_caller_saved_ : 0;
+            int c = -1;
+            for (int i = first; i < K(); i++)
+            {
+                if (!used[i])
+                {
+                    c = i;
+                    break;
+                }
+            }
+            if (c == -1)
+            {
+                state_[n] = NodeState::Spilled;
+            }
+            else
+            {
+                state_[n] = NodeState::Colored;
+                color_[n] = c;
+            }
+        }
+    }
+
+    // 把着色结果展开为每条指令的 InstrAlloc
+    void record_allocation()
+    {
+        std::unordered_map<int, int> spill_slot;  // alias root -> offset
+        int next_spill_offset = 0;                 // 溢出区内的偏移，由代码生成器放进栈帧
+        std::vector<std::string> reg(names_.size());
+        std::vector<int> offset(names_.size(), -1);
+        for (int n = 0; n < (int)names_.size(); n++)
+        {
+            int a = get_alias(n);
+            if (state_[a] == NodeState::Colored)
+            {
+                reg[n] = colors_[color_[a]];
+                continue;
+            }
+            auto it = spill_slot.find(a);
+            if (it == spill_slot.end())
+            {
+                it = spill_slot.emplace(a, next_spill_offset).first;
+                next_spill_offset += 4;
+                spill_count_++;
+            }
+            offset[n] = it->second;
+        }
+
+        for (int i = 0; i < (int)func_->instrs.size(); i++)
+        {
+            const TacInstr &instr = func_->instrs[i];
+            std::vector<const std::string *> vars = instr_use_slots(instr);
+            if (instr_has_def(instr))
+                vars.push_back(&instr.dest);
+            for (const std::string *var : vars)
+            {
+                auto it = node_index_.find(*var);
+                if (it == node_index_.end())
+                    continue;
+                int n = it->second;
+                if (!reg[n].empty())
+                    allocation_[i].reg_map[*var] = reg[n];
+                else
+                    allocation_[i].spill_offset[*var] = offset[n];
+            }
+        }
+    }
+};
+
+#endif // GRAPH_ALLOCATOR_H
@@ -0,0 +1,339 @@
+#ifndef OUT_OF_SSA_H
+#define OUT_OF_SSA_H
+
+#include "ir/tac.h"
+#include "ir/cfg.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+// Out-of-SSA translation run by the backend before register allocation.
+//
+// 1. Critical edges into blocks with PHIs are split, so every PHI operand
+//    has an edge of its own to hold its copy.
+// 2. The PHIs of a block become one parallel copy per incoming edge, which is
+//    sequentialized at the end of the predecessor (cycles go through a temp).
+// 3. Copies (MOVE, and LOAD/STORE on named slots, which are register copies in
+//    this backend) are coalesced whenever source and destination do not
+//    interfere, so the allocator never sees the chains SSA leaves behind.
+class OutOfSSA
+{
+public:
+    explicit OutOfSSA(FunctionIR *func) : func_(func) {}
+
+    void run()
+    {
+        if (func_->instrs.empty())
+            return;
+
+        // A function that falls off its end gets an explicit RET, so split
+        // edge blocks can be appended after the last block
+        TacOp last_op = func_->instrs.back().op;
+        if (last_op != TacOp::RET && last_op != TacOp::JUMP)
+        {
+            func_->instrs.emplace_back(TacOp::RET);
+        }
+
+        func_->build_cfg();
+        if (has_phis())
+        {
+            split_critical_edges();
+            lower_phis();
+        }
+        coalesce_copies();
+        func_->build_cfg();
+    }
+
+private:
+    FunctionIR *func_;
+
+    bool has_phis() const
+    {
+        for (const auto &instr : func_->instrs)
+        {
+            if (instr.op == TacOp::PHI)
+                return true;
+        }
+        return false;
+    }
+
+    static bool block_has_phis(const BasicBlock &block)
+    {
+        for (const auto &instr : block.instrs)
+        {
+            if (instr.op == TacOp::PHI)
+                return true;
+        }
+        return false;
+    }
+
+    // Split every edge P -> B where P has several successors and B has PHIs
+    void split_critical_edges()
+    {
+        std::vector<BasicBlock> &blocks = func_->blocks;
+        std::vector<std::vector<TacInstr>> after_block(blocks.size());  // fall-through splits
+        std::vector<TacInstr> appended;                                 // branch-target splits
+
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            BasicBlock &block = blocks[b];
+            if (!block_has_phis(block))
+                continue;
+
+            for (const auto &pred_name : block.predecessors)
+            {
+                BasicBlock &pred = blocks[func_->block_index[pred_name]];
+                if (pred.successors.size() < 2)
+                    continue;
+
+                std::string edge_label = func_->next_label();
+                TacInstr &branch = pred.instrs.back();
+                bool is_fallthrough = branch_target(branch) != block.label;
+
+                if (is_fallthrough)
+                {
+                    // Sits between pred and block in layout and falls through
+                    after_block[func_->block_index[pred_name]].emplace_back(TacOp::LABEL, "", "", edge_label);
+                }
+                else
+                {
+                    branch.src2 = edge_label;
+                    appended.emplace_back(TacOp::LABEL, "", "", edge_label);
+                    appended.emplace_back(TacOp::JUMP, "", "", block.label);
+                }
+
+                for (auto &instr : block.instrs)
+                {
+                    if (instr.op != TacOp::PHI)
+                        continue;
+                    for (auto &arg : instr.phi_args)
+                    {
+                        if (arg.first == pred.label)
+                            arg.first = edge_label;
+                    }
+                }
+            }
+        }
+
+        std::vector<TacInstr> instrs;
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            instrs.insert(instrs.end(), blocks[b].instrs.begin(), blocks[b].instrs.end());
+            instrs.insert(instrs.end(), after_block[b].begin(), after_block[b].end());
+        }
+        instrs.insert(instrs.end(), appended.begin(), appended.end());
+        func_->instrs = std::move(instrs);
+        func_->build_cfg();
+    }
+
+    // Replace the PHIs of each block with copies at the end of its predecessors
+    void lower_phis()
+    {
+        std::vector<BasicBlock> &blocks = func_->blocks;
+        std::unordered_map<std::string, int> label_block;
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            if (!blocks[b].label.empty())
+                label_block[blocks[b].label] = b;
+        }
+
+        // Parallel copy (dest <- src) per predecessor block
+        std::vector<std::vector<std::pair<std::string, std::string>>> edge_copies(blocks.size());
+        for (auto &block : blocks)
+        {
+            std::vector<TacInstr> kept;
+            for (const auto &instr : block.instrs)
+            {
+                if (instr.op != TacOp::PHI)
+                {
+                    kept.push_back(instr);
+                    continue;
+                }
+                for (const auto &arg : instr.phi_args)
+                {
+                    auto it = label_block.find(arg.first);
+                    if (it != label_block.end())
+                        edge_copies[it->second].push_back({instr.dest, arg.second});
+                }
+            }
+            block.instrs = std::move(kept);
+        }
+
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            if (edge_copies[b].empty())
+                continue;
+            std::vector<TacInstr> moves = sequentialize(edge_copies[b]);
+            std::vector<TacInstr> &instrs = blocks[b].instrs;
+            auto pos = instrs.end();
+            if (is_terminator(instrs.back().op))
+                pos = instrs.end() - 1;
+            instrs.insert(pos, moves.begin(), moves.end());
+        }
+
+        func_->flatten_blocks();
+    }
+
+    // Order a parallel copy so no source is overwritten before it is read;
+    // a cycle is broken by saving one destination in a fresh temp
+    std::vector<TacInstr> sequentialize(std::vector<std::pair<std::string, std::string>> copies)
+    {
+        std::vector<TacInstr> moves;
+        copies.erase(std::remove_if(copies.begin(), copies.end(),
+                                    [](const std::pair<std::string, std::string> &c)
+                                    { return c.first == c.second; }),
+                     copies.end());
+
+        while (!copies.empty())
+        {
+            bool progress = false;
+            for (size_t i = 0; i < copies.size(); i++)
+            {
+                const std::string &dest = copies[i].first;
+                bool dest_still_read = false;
+                for (size_t j = 0; j < copies.size(); j++)
+                {
+                    if (j != i && copies[j].second == dest)
+                    {
+                        dest_still_read = true;
+                        break;
+                    }
+                }
+                if (!dest_still_read)
+                {
+                    moves.emplace_back(TacOp::MOVE, copies[i].first, copies[i].second);
+                    copies.erase(copies.begin() + i);
+                    progress = true;
+                    break;
+                }
+            }
+            if (progress)
+                continue;
+
+            // Only cycles remain: park one destination's old value in a temp
+            std::string saved = copies[0].first;
+            std::string tmp = func_->next_temp();
+            moves.emplace_back(TacOp::MOVE, tmp, saved);
+            for (auto &copy : copies)
+            {
+                if (copy.second == saved)
+                    copy.second = tmp;
+            }
+        }
+        return moves;
+    }
+
+    // Copy source/destination, or false if the instruction is not a copy
+    static bool copy_operands(const TacInstr &instr, std::string &dest, std::string &src)
+    {
+        if (instr.op != TacOp::MOVE && instr.op != TacOp::STORE && instr.op != TacOp::LOAD)
+            return false;
+        if (!is_variable(instr.dest) || !is_variable(instr.src1))
+            return false;
+        dest = instr.dest;
+        src = instr.src1;
+        return true;
+    }
+
+    std::unordered_map<std::string, std::string> leader_;
+
+    std::string find(const std::string &var)
+    {
+        auto it = leader_.find(var);
+        if (it == leader_.end() || it->second == var)
+            return var;
+        std::string root = find(it->second);
+        leader_[var] = root;
+        return root;
+    }
+
+    // Aggressive coalescing over a Chaitin-style interference graph: a copy's
+    // destination does not interfere with its source at the copy itself
+    void coalesce_copies()
+    {
+        func_->build_cfg();
+        func_->compute_liveness();
+
+        std::unordered_map<std::string, std::unordered_set<std::string>> interference;
+        for (const auto &block : func_->blocks)
+        {
+            std::unordered_set<std::string> live;
+            for (const auto &v : block.live_out)
+            {
+                if (is_variable(v))
+                    live.insert(v);
+            }
+            for (auto it = block.instrs.rbegin(); it != block.instrs.rend(); ++it)
+            {
+                const TacInstr &instr = *it;
+                if (instr.op == TacOp::LABEL)
+                    continue;
+                std::string copy_dest, copy_src;
+                bool is_copy = copy_operands(instr, copy_dest, copy_src);
+
+                if (instr_has_def(instr) && is_variable(instr.dest))
+                {
+                    for (const auto &v : live)
+                    {
+                        if (v == instr.dest || (is_copy && v == copy_src))
+                            continue;
+                        interference[instr.dest].insert(v);
+                        interference[v].insert(instr.dest);
+                    }
+                    live.erase(instr.dest);
+                }
+                for (const std::string *slot : instr_use_slots(instr))
+                {
+                    if (is_variable(*slot))
+                        live.insert(*slot);
+                }
+            }
+        }
+
+        leader_.clear();
+        for (const auto &instr : func_->instrs)
+        {
+            std::string dest, src;
+            if (!copy_operands(instr, dest, src))
+                continue;
+            std::string a = find(dest);
+            std::string b = find(src);
+            if (a == b || interference[a].count(b))
+                continue;
+
+            // Keep user variable names as leaders for the allocator's heuristics
+            if (is_temp(b) && !is_temp(a))
+                std::swap(a, b);
+            leader_[a] = b;
+            for (const auto &n : interference[a])
+            {
+                interference[b].insert(n);
+                interference[n].erase(a);
+                interference[n].insert(b);
+            }
+            interference.erase(a);
+        }
+
+        std::vector<TacInstr> instrs;
+        for (auto instr : func_->instrs)
+        {
+            for (std::string *slot : instr_use_slots(instr))
+            {
+                if (is_variable(*slot))
+                    *slot = find(*slot);
+            }
+            if (instr_has_def(instr) && is_variable(instr.dest))
+                instr.dest = find(instr.dest);
+
+            std::string dest, src;
+            if (copy_operands(instr, dest, src) && dest == src)
+                continue;
+            instrs.push_back(instr);
+        }
+        func_->instrs = std::move(instrs);
+    }
+};
+
+#endif // OUT_OF_SSA_H
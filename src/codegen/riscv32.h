@@ -2,18 +2,25 @@
 #define RISCV32_H
 
 #include "ir/tac.h"
+#include "ir/cfg.h"
 #include "codegen/allocator.h"
+#include "codegen/graph_allocator.h"
+#include "codegen/out_of_ssa.h"
+#include "codegen/frame.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
 #include <cctype>
+#include <cstdint>
 #include <algorithm>
 #include <sstream>
 
 class RISC32Generator {
 public:
-    RISC32Generator(ProgramIR* ir) : program_ir_(ir) {}
+    RISC32Generator(ProgramIR* ir, bool graph_coloring = false, int mul_cost = 1)
+        : program_ir_(ir), graph_coloring_(graph_coloring), mul_cost_(mul_cost) {}
 
     std::string generate() {
         output_ = "";
@@ -31,105 +38,635 @@ public:
 
 private:
     ProgramIR* program_ir_;
+    bool graph_coloring_;  // Use GraphColoringAllocator instead of linear scan
+    int mul_cost_;         // Cycles of a mul on the target core (see multiply_chain)
+    FunctionIR* current_func_ = nullptr;
     std::string output_;
+    FrameLayout frame_;
+    int sp_offset_ = 0;  // Bytes of outgoing argument areas currently below the frame
+    // Sibling calls: CALL index -> index of the RET it replaces
+    std::unordered_map<size_t, size_t> tail_calls_;
+    // First PARAM index -> index of the CALL it sets up
+    std::unordered_map<size_t, size_t> arg_groups_;
+    // Arguments 8 and up, by PARAM index
+    struct StackArg {
+        int offset;        // From the callee's entry sp
+        bool reuse_frame;  // Sibling call: store into our incoming argument area
+    };
+    std::unordered_map<size_t, StackArg> stack_args_;
+    // CALL index -> outgoing area reserved around the call, in bytes
+    std::unordered_map<size_t, int> stack_areas_;
+    // Comparisons emitted as one conditional branch with the BEQZ/BNEZ after them
+    std::unordered_set<size_t> fused_branches_;
 
     void generate_function(FunctionIR* func) {
         // Skip internal functions starting with '.'
         if (!func->name.empty() && func->name[0] == '.') {
             return;
         }
+        current_func_ = func;
+
+        select_immediates(func);
+        group_call_arguments(func);
+
+        // Leave SSA form and coalesce copies before allocation
+        OutOfSSA out_of_ssa(func);
+        out_of_ssa.run();
+
+        // Allocate registers, then lay out the frame and generate code
+        if (graph_coloring_) {
+            GraphColoringAllocator allocator(func);
+            allocator.allocate();
+            generate_allocated(func, allocator);
+        } else {
+            LinearScanAllocator allocator(func);
+            allocator.allocate();
+            generate_allocated(func, allocator);
+        }
+    }
+
+    template <typename Allocator>
+    void generate_allocated(FunctionIR* func, const Allocator& allocator) {
+        plan_calls(func);
+        plan_branches(func, allocator);
+        compute_frame(func, allocator);
 
         output_ += "\t.globl " + func->name + "\n";
         output_ += func->name + ":\n";
 
         // Generate prologue
         output_ += "prologue_" + func->name + ":\n";
-        // Use s0 as frame pointer
-        output_ += "\taddi s0, sp, 0\n";
-        output_ += "\taddi sp, sp, -4\n";
-        output_ += "\tsw ra, 0(sp)\n";
+        if (frame_.size > 0) {
+            emit_sp_adjust(-frame_.size);
+            if (frame_.ra_offset >= 0) {
+                output_ += "\tsw ra, " + frame_slot(frame_.ra_offset, "t0") + "\n";
+            }
+            for (const auto& saved : frame_.saved_regs) {
+                output_ += "\tsw " + saved.first + ", " + frame_slot(saved.second, "t0") + "\n";
+            }
+        }
 
-        // Allocate register and generate code
-        LinearScanAllocator allocator(func);
-        allocator.allocate();
+        generate_body(func, allocator);
 
-        // Generate TAC instructions
+        // Generate epilogue
+        output_ += "epilogue_" + func->name + ":\n";
+        emit_frame_teardown();
+        output_ += "\tret\n";
+    }
+
+    // A comparison whose result is only tested by the BEQZ/BNEZ right after
+    // it becomes a single blt/bge/beq/bne on its operands. The allocator
+    // still gave the 0/1 result a register, which simply goes unused. Not
+    // done when the branch has split values to reload or write back first:
+    // those may reuse the registers of the compared values.
+    template <typename Allocator>
+    void plan_branches(FunctionIR* func, const Allocator& allocator) {
+        fused_branches_.clear();
+        const auto& instrs = func->instrs;
+        std::unordered_map<std::string, int> uses;
+        for (const auto& instr : instrs) {
+            for (const std::string* slot : instr_use_slots(instr)) uses[*slot]++;
+        }
+        for (size_t i = 0; i + 1 < instrs.size(); i++) {
+            const TacInstr& cmp = instrs[i];
+            const TacInstr& branch = instrs[i + 1];
+            if (cmp.op != TacOp::LT && cmp.op != TacOp::GT && cmp.op != TacOp::LE &&
+                cmp.op != TacOp::GE && cmp.op != TacOp::EQ && cmp.op != TacOp::NE) continue;
+            if (branch.op != TacOp::BEQZ && branch.op != TacOp::BNEZ) continue;
+            if (branch.src1 != cmp.dest || !is_variable(cmp.dest) || uses[cmp.dest] != 1) continue;
+            const InstrAlloc& alloc = allocator.get_allocation(i + 1);
+            if (!alloc.reload.empty() || !alloc.write_back.empty()) continue;
+            fused_branches_.insert(i);
+        }
+    }
+
+    // Size the frame from what the allocator used: its spill slots, the
+    // s-registers it handed out, the caller-saved registers it keeps live
+    // across calls, and ra unless every call is a sibling call
+    template <typename Allocator>
+    void compute_frame(FunctionIR* func, const Allocator& allocator) {
+        bool has_calls = false;
+        std::set<std::string> used_regs;
+        int spill_bytes = 0;
+        int caller_save_bytes = 0;
+        for (size_t i = 0; i < func->instrs.size(); i++) {
+            if (func->instrs[i].op == TacOp::CALL && !tail_calls_.count(i)) has_calls = true;
+            const InstrAlloc& alloc = allocator.get_allocation(i);
+            for (const auto& entry : alloc.reg_map) used_regs.insert(entry.second);
+            for (const auto& entry : alloc.spill_offset) spill_bytes = std::max(spill_bytes, entry.second + 4);
+            caller_save_bytes = std::max(caller_save_bytes, 4 * (int)alloc.caller_saved.size());
+        }
+        frame_.compute(has_calls, used_regs, spill_bytes, caller_save_bytes);
+        sp_offset_ = 0;
+    }
+
+    // sp += delta, through t0 when delta does not fit an immediate
+    void emit_sp_adjust(int delta) {
+        if (delta >= -2048 && delta <= 2047) {
+            output_ += "\taddi sp, sp, " + std::to_string(delta) + "\n";
+        } else {
+            output_ += "\tli t0, " + std::to_string(delta) + "\n";
+            output_ += "\tadd sp, sp, t0\n";
+        }
+    }
+
+    // Memory operand for a frame offset, accounting for open outgoing
+    // argument areas. Offsets beyond the 12-bit immediate go through scratch.
+    std::string frame_slot(int offset, const std::string& scratch) {
+        int off = offset + sp_offset_;
+        if (off >= -2048 && off <= 2047) return std::to_string(off) + "(sp)";
+        output_ += "\tli " + scratch + ", " + std::to_string(off) + "\n";
+        output_ += "\tadd " + scratch + ", " + scratch + ", sp\n";
+        return "0(" + scratch + ")";
+    }
+
+    // Restore ra and the saved registers and release the frame; sp is back
+    // at its value on entry
+    void emit_frame_teardown() {
+        if (frame_.size == 0) return;
+        if (frame_.ra_offset >= 0) {
+            output_ += "\tlw ra, " + frame_slot(frame_.ra_offset, "t0") + "\n";
+        }
+        for (const auto& saved : frame_.saved_regs) {
+            output_ += "\tlw " + saved.first + ", " + frame_slot(saved.second, "t0") + "\n";
+        }
+        emit_sp_adjust(frame_.size);
+    }
+
+    static bool fits_imm12(long long value) {
+        return value >= -2048 && value <= 2047;
+    }
+
+    // Whether `op` with the literal `value` as src2 has an I-type form:
+    //     ADD addi c        SUB addi -c
+    //     LT  slti c        GE  slti c; xori 1
+    //     LE  slti c+1      GT  slti c+1; xori 1
+    //     EQ  addi -c; seqz NE  addi -c; snez
+    // AND and OR with a literal reduce to snez or a constant, and DIV and MOD
+    // by a non-zero literal to multiplies and shifts (emit_divide_by_constant).
+    // MUL takes a literal whose shift/add chain is no slower than a mul on
+    // the target core (multiply_chain).
+    bool has_immediate_form(TacOp op, long long value) const {
+        switch (op) {
+            case TacOp::MUL:
+                return (int32_t)value == 0 ||
+                       std::max<size_t>(multiply_chain((int32_t)value).size(), 1) <= (size_t)mul_cost_;
+            case TacOp::DIV: case TacOp::MOD:
+                return value != 0;
+            case TacOp::ADD: case TacOp::LT: case TacOp::GE:
+                return fits_imm12(value);
+            case TacOp::SUB: case TacOp::EQ: case TacOp::NE:
+                return fits_imm12(-value);
+            case TacOp::LE: case TacOp::GT:
+                return fits_imm12(value + 1);
+            case TacOp::AND: case TacOp::OR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Instruction selection for constant operands. IRBuilder gives every
+    // constant its own LOAD_IMM temp; where an operand defined only by a
+    // LOAD_IMM has an immediate form, the literal replaces the temp
+    // (commutative operands and mirrored comparisons are swapped into src2
+    // first). Zero is folded into any operand since it reads `zero`, and
+    // copies of a constant become LOAD_IMMs of their own. Temps left without
+    // uses lose their LOAD_IMM, and with it a register.
+    void select_immediates(FunctionIR* func) {
+        auto& instrs = func->instrs;
+        std::unordered_map<std::string, int> defs;
+        std::unordered_map<std::string, std::string> constants;
+        for (const auto& instr : instrs) {
+            if (!instr_has_def(instr) || !is_variable(instr.dest)) continue;
+            defs[instr.dest]++;
+            if (instr.op == TacOp::LOAD_IMM) constants[instr.dest] = instr.src1;
+        }
+        auto constant = [&](const std::string& var) -> const std::string* {
+            auto it = constants.find(var);
+            return it != constants.end() && defs[var] == 1 ? &it->second : nullptr;
+        };
+
+        for (auto& instr : instrs) {
+            switch (instr.op) {
+                case TacOp::MOVE: case TacOp::STORE: case TacOp::PARAM: {
+                    const std::string* value = constant(instr.src1);
+                    if (!value) break;
+                    instr.src1 = *value;
+                    if (instr.op != TacOp::PARAM && is_variable(instr.dest)) instr.op = TacOp::LOAD_IMM;
+                    break;
+                }
+                case TacOp::ADD: case TacOp::SUB: case TacOp::MUL: case TacOp::DIV: case TacOp::MOD:
+                case TacOp::AND: case TacOp::OR:
+                case TacOp::LT: case TacOp::GT: case TacOp::LE: case TacOp::GE:
+                case TacOp::EQ: case TacOp::NE: {
+                    const std::string* left = constant(instr.src1);
+                    const std::string* right = constant(instr.src2);
+                    if (left && !right && !is_number(instr.src2)) {
+                        static const std::unordered_map<int, TacOp> mirrored = {
+                            {(int)TacOp::ADD, TacOp::ADD}, {(int)TacOp::MUL, TacOp::MUL},
+                            {(int)TacOp::AND, TacOp::AND},
+                            {(int)TacOp::OR, TacOp::OR}, {(int)TacOp::EQ, TacOp::EQ},
+                            {(int)TacOp::NE, TacOp::NE}, {(int)TacOp::LT, TacOp::GT},
+                            {(int)TacOp::GT, TacOp::LT}, {(int)TacOp::LE, TacOp::GE},
+                            {(int)TacOp::GE, TacOp::LE}};
+                        auto it = mirrored.find((int)instr.op);
+                        if (it != mirrored.end() && has_immediate_form(it->second, std::stoll(*left))) {
+                            instr.op = it->second;
+                            std::swap(instr.src1, instr.src2);
+                            std::swap(left, right);
+                        }
+                    }
+                    if (right && (*right == "0" || has_immediate_form(instr.op, std::stoll(*right)))) {
+                        instr.src2 = *right;
+                    }
+                    if (left && *left == "0") instr.src1 = "0";
+                    break;
+                }
+                case TacOp::NOT: case TacOp::BEQZ: case TacOp::BNEZ: {
+                    const std::string* value = constant(instr.src1);
+                    if (value && *value == "0") instr.src1 = "0";
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        std::unordered_set<std::string> used;
+        for (const auto& instr : instrs) {
+            for (const std::string* slot : instr_use_slots(instr)) used.insert(*slot);
+        }
+        instrs.erase(std::remove_if(instrs.begin(), instrs.end(), [&](const TacInstr& instr) {
+            return instr.op == TacOp::LOAD_IMM && constant(instr.dest) && !used.count(instr.dest);
+        }), instrs.end());
+    }
+
+    // Move the PARAMs of every call right before its CALL. IRBuilder
+    // interleaves them with the evaluation of the remaining arguments,
+    // including nested calls that set up the same a-registers; a PARAM that
+    // is not already in place copies its value into a fresh temp where it
+    // stands, and the temp is passed at the CALL instead.
+    void group_call_arguments(FunctionIR* func) {
+        auto& instrs = func->instrs;
+        std::unordered_map<int, int> param_call;  // PARAM index -> CALL index
+        for (int i = 0; i < (int)instrs.size(); i++) {
+            if (instrs[i].op != TacOp::CALL) continue;
+            FunctionIR* callee = program_ir_->get_function(instrs[i].src1);
+            if (!callee || callee->params.empty()) continue;
+            std::vector<std::string> args;
+            std::vector<int> positions;
+            if (!call_arguments(program_ir_, instrs, i, callee->params.size(), args, positions, false)) continue;
+            for (int pos : positions) param_call[pos] = i;
+        }
+        if (param_call.empty()) return;
+
+        std::vector<TacInstr> grouped;
+        std::unordered_map<int, std::vector<TacInstr>> pending;  // CALL index -> its PARAMs
+        for (int i = 0; i < (int)instrs.size(); i++) {
+            auto it = param_call.find(i);
+            if (it != param_call.end()) {
+                int call = it->second;
+                bool in_place = true;
+                for (int j = i + 1; j < call && in_place; j++) {
+                    auto other = param_call.find(j);
+                    in_place = other != param_call.end() && other->second == call;
+                }
+                TacInstr param = instrs[i];
+                if (!in_place && is_variable(param.src1)) {
+                    std::string temp = func->next_temp();
+                    grouped.push_back(TacInstr(TacOp::MOVE, temp, param.src1));
+                    param.src1 = temp;
+                }
+                pending[call].push_back(param);
+                continue;
+            }
+            auto params = pending.find(i);
+            if (params != pending.end()) {
+                grouped.insert(grouped.end(), params->second.begin(), params->second.end());
+            }
+            grouped.push_back(instrs[i]);
+        }
+        instrs = std::move(grouped);
+    }
+
+    // Plan the calls of a function before emitting it.
+    //
+    // A call whose result is returned right away
+    //     CALL r, f; MOVE a0, r; RET      or      CALL r, f; RET
+    // (or that falls into the epilogue) is a sibling call: the frame is torn
+    // down and the CALL becomes a plain jump, so the callee reuses our frame
+    // and returns straight to our caller.
+    //
+    // The PARAMs right before a CALL are its arguments (see
+    // group_call_arguments) and are set up together as one parallel move.
+    //
+    // Arguments 8 and up go on the stack at the callee's entry sp. A normal
+    // call reserves an outgoing area below sp while its arguments are set up
+    // and releases it after the CALL. A sibling call instead stores them
+    // into our own incoming argument area, so the callee may not take more
+    // stack arguments than we received.
+    void plan_calls(FunctionIR* func) {
+        tail_calls_.clear();
+        arg_groups_.clear();
+        stack_args_.clear();
+        stack_areas_.clear();
+
+        const auto& instrs = func->instrs;
+        int incoming = std::max(0, (int)func->params.size() - 8);
+        int last_incoming_load = -1;  // Incoming stack arguments are read up to here
+        for (size_t i = 0; i < instrs.size(); i++) {
+            if (param_load_index(instrs[i]) >= 8) last_incoming_load = i;
+        }
+
+        for (size_t i = 0; i < instrs.size(); i++) {
+            if (instrs[i].op != TacOp::CALL) continue;
+            size_t first = i;
+            while (first > 0 && instrs[first - 1].op == TacOp::PARAM) first--;
+            if (first < i) arg_groups_[first] = i;
+
+            FunctionIR* callee = program_ir_->get_function(instrs[i].src1);
+            if (!callee) continue;
+
+            size_t ret = i + 1;
+            if (ret < instrs.size() && instrs[ret].op == TacOp::MOVE && instrs[ret].dest == "a0" &&
+                instrs[ret].src1 == instrs[i].dest) {
+                ret++;
+            }
+            bool tail = ret >= instrs.size() || instrs[ret].op == TacOp::RET;
+
+            size_t count = callee->params.size();
+            if (count <= 8) {
+                if (tail) tail_calls_[i] = ret;
+                continue;
+            }
+            std::vector<std::string> args;
+            std::vector<int> positions;
+            if (!call_arguments(program_ir_, instrs, i, count, args, positions, false)) continue;
+
+            int outgoing = count - 8;
+            bool reuse_frame = tail && outgoing <= incoming;
+            for (int pos : positions) {
+                if (pos <= last_incoming_load) reuse_frame = false;
+            }
+            for (int pos : positions) {
+                int index = std::stoi(instrs[pos].dest.substr(1));
+                if (index >= 8) stack_args_[pos] = {(index - 8) * 4, reuse_frame};
+            }
+            if (reuse_frame) {
+                tail_calls_[i] = ret;
+            } else {
+                stack_areas_[i] = (outgoing * 4 + 15) / 16 * 16;  // Keep sp 16-byte aligned
+            }
+        }
+    }
+
+    // Generate TAC instructions with any allocator exposing get_allocation(i)
+    template <typename Allocator>
+    void generate_body(FunctionIR* func, const Allocator& allocator) {
         for (size_t i = 0; i < func->instrs.size(); i++) {
             const auto& instr = func->instrs[i];
             const auto& alloc = allocator.get_allocation(i);
 
+            // The last RET falls straight into the epilogue
+            if (instr.op == TacOp::RET && i + 1 == func->instrs.size()) {
+                continue;
+            }
+            auto group = arg_groups_.find(i);
+            if (group != arg_groups_.end()) {
+                emit_arguments(func, allocator, i, group->second);
+                i = group->second - 1;
+                continue;
+            }
+            auto tail = tail_calls_.find(i);
+            if (tail != tail_calls_.end()) {
+                // The callee's result is already in a0
+                emit_reloads(alloc);
+                emit_frame_teardown();
+                output_ += "\ttail " + instr.src1 + "\n";
+                i = tail->second;
+                continue;
+            }
+            if (fused_branches_.count(i)) {
+                emit_reloads(alloc);
+                emit_compare_branch(instr, func->instrs[i + 1], alloc);
+                i++;
+                continue;
+            }
             generate_instruction(instr, alloc);
+            auto area = stack_areas_.find(i);
+            if (area != stack_areas_.end()) {
+                output_ += "\taddi sp, sp, " + std::to_string(area->second) + "\n";
+                sp_offset_ -= area->second;
+            }
         }
+    }
 
-        // Generate epilogue
-        output_ += "epilogue_" + func->name + ":\n";
-        output_ += "\tlw ra, 0(sp)\n";
-        output_ += "\taddi sp, sp, 4\n";
-        output_ += "\tret\n";
+    // Set up the arguments of the CALL at `call` from the PARAMs in
+    // [first, call) as one parallel move. Stack arguments are stored first,
+    // since stores only read registers. A register move is then emitted once
+    // no other pending move still reads its destination; when only cycles
+    // remain, one destination is parked in t0 and its readers read t0
+    // instead. Values in memory and literals are loaded last.
+    template <typename Allocator>
+    void emit_arguments(FunctionIR* func, const Allocator& allocator, size_t first, size_t call) {
+        emit_reloads(allocator.get_allocation(first));
+        auto area = stack_areas_.find(call);
+        if (area != stack_areas_.end()) {
+            output_ += "\taddi sp, sp, -" + std::to_string(area->second) + "\n";
+            sp_offset_ += area->second;
+        }
+
+        std::vector<std::pair<std::string, std::string>> moves;  // dest <- src register
+        std::vector<size_t> loads;
+        for (size_t i = first; i < call; i++) {
+            const TacInstr& param = func->instrs[i];
+            const InstrAlloc& alloc = allocator.get_allocation(i);
+            auto stack_arg = stack_args_.find(i);
+            if (stack_arg != stack_args_.end()) {
+                const StackArg& arg = stack_arg->second;
+                std::string rs = src_reg(param.src1, alloc, "t0");
+                std::string slot = arg.reuse_frame ? frame_slot(frame_.incoming_arg(arg.offset), "t1")
+                                                   : std::to_string(arg.offset) + "(sp)";
+                output_ += "\tsw " + rs + ", " + slot + "\n";
+                continue;
+            }
+            std::string reg = is_physical_reg(param.src1) ? param.src1 : "";
+            auto reg_it = alloc.reg_map.find(param.src1);
+            if (reg_it != alloc.reg_map.end()) reg = reg_it->second;
+            if (reg.empty()) {
+                loads.push_back(i);
+            } else if (reg != param.dest) {
+                moves.push_back({param.dest, reg});
+            }
+        }
+
+        while (!moves.empty()) {
+            bool emitted = false;
+            for (size_t m = 0; m < moves.size() && !emitted; m++) {
+                bool still_read = false;
+                for (size_t k = 0; k < moves.size(); k++) {
+                    if (k != m && moves[k].second == moves[m].first) still_read = true;
+                }
+                if (still_read) continue;
+                output_ += "\taddi " + moves[m].first + ", " + moves[m].second + ", 0\n";
+                moves.erase(moves.begin() + m);
+                emitted = true;
+            }
+            if (!emitted) {
+                std::string parked = moves[0].first;
+                output_ += "\taddi t0, " + parked + ", 0\n";
+                for (auto& move : moves) {
+                    if (move.second == parked) move.second = "t0";
+                }
+            }
+        }
+        for (size_t i : loads) {
+            emit_copy(func->instrs[i].dest, func->instrs[i].src1, allocator.get_allocation(i));
+        }
     }
 
-    void generate_instruction(const TacInstr& instr, const LinearScanAllocator::InstrAlloc& alloc) {
-        // Handle labels
-        if (instr.op == TacOp::LABEL) {
-            output_ += instr.src2 + ":\n";
-            return;
+    // Register holding `var` at this instruction. Literals, rematerialized
+    // constants and spilled values are brought into `scratch` first; physical
+    // registers name themselves.
+    std::string src_reg(const std::string& var, const InstrAlloc& alloc,
+                        const std::string& scratch) {
+        if (is_number(var)) {
+            if (var == "0") return "zero";
+            output_ += "\tli " + scratch + ", " + var + "\n";
+            return scratch;
         }
+        if (is_physical_reg(var)) return var;
+        auto reg_it = alloc.reg_map.find(var);
+        if (reg_it != alloc.reg_map.end()) return reg_it->second;
+        auto remat_it = alloc.remat.find(var);
+        if (remat_it != alloc.remat.end()) return src_reg(remat_it->second, alloc, scratch);
+        auto spill_it = alloc.spill_offset.find(var);
+        if (spill_it != alloc.spill_offset.end()) {
+            output_ += "\tlw " + scratch + ", " + spill_slot(spill_it->second, scratch) + "\n";
+            return scratch;
+        }
+        return "zero";  // never defined: any value will do
+    }
+
+    // Register an instruction should write `var` into; spilled values are
+    // computed into `scratch` and written back by store_dest
+    std::string dest_reg(const std::string& var, const InstrAlloc& alloc,
+                         const std::string& scratch) const {
+        if (is_physical_reg(var)) return var;
+        auto reg_it = alloc.reg_map.find(var);
+        if (reg_it != alloc.reg_map.end()) return reg_it->second;
+        return scratch;
+    }
 
-        // Get register allocations (using const-safe methods)
-        auto dest_it = alloc.reg_map.find(instr.dest);
-        std::string dest_reg = dest_it != alloc.reg_map.end() ? dest_it->second : "";
+    // Memory operand for a spill slot; the allocators number slots from 0
+    std::string spill_slot(int offset, const std::string& scratch) {
+        return frame_slot(frame_.spill_base + offset, scratch);
+    }
 
-        auto src1_it = alloc.reg_map.find(instr.src1);
-        std::string src1_reg = src1_it != alloc.reg_map.end() ? src1_it->second : "";
+    // Also writes through to the stack slot of a split value
+    void store_dest(const std::string& var, const InstrAlloc& alloc,
+                    const std::string& reg) {
+        if (is_physical_reg(var)) return;
+        auto spill_it = alloc.spill_offset.find(var);
+        if (spill_it != alloc.spill_offset.end()) {
+            output_ += "\tsw " + reg + ", " + spill_slot(spill_it->second, reg == "t1" ? "t0" : "t1") + "\n";
+        }
+    }
 
-        auto src2_it = alloc.reg_map.find(instr.src2);
-        std::string src2_reg = src2_it != alloc.reg_map.end() ? src2_it->second : "";
+    // Split values leaving a loop go back to their slot, and split values
+    // re-entering a register are loaded from it (or recomputed, for constants)
+    void emit_reloads(const InstrAlloc& alloc) {
+        for (const auto& var : alloc.write_back) {
+            const std::string& reg = alloc.reg_map.at(var);
+            output_ += "\tsw " + reg + ", " + spill_slot(alloc.spill_offset.at(var), "t0") + "\n";
+        }
+        for (const auto& var : alloc.reload) {
+            const std::string& reg = alloc.reg_map.at(var);
+            auto remat_it = alloc.remat.find(var);
+            if (remat_it != alloc.remat.end()) {
+                output_ += "\tli " + reg + ", " + remat_it->second + "\n";
+                continue;
+            }
+            output_ += "\tlw " + reg + ", " + spill_slot(alloc.spill_offset.at(var), reg) + "\n";
+        }
+    }
 
-        // Handle spilled variables
-        auto dest_offset_it = alloc.spill_offset.find(instr.dest);
-        int dest_offset = dest_offset_it != alloc.spill_offset.end() ? dest_offset_it->second : -1;
+    // dest = src for any mix of registers, spill slots and literals
+    void emit_copy(const std::string& dest, const std::string& src,
+                   const InstrAlloc& alloc) {
+        std::string rd = dest_reg(dest, alloc, "t0");
+        if (is_number(src) && src != "0") {
+            output_ += "\tli " + rd + ", " + src + "\n";
+        } else {
+            std::string rs = src_reg(src, alloc, rd);
+            if (rs != rd) {
+                if (!is_physical_reg(dest) && !alloc.reg_map.count(dest)) {
+                    // Spilled destination: store the source directly
+                    store_dest(dest, alloc, rs);
+                    return;
+                }
+                output_ += "\taddi " + rd + ", " + rs + ", 0\n";
+            }
+        }
+        store_dest(dest, alloc, rd);
+    }
 
-        auto src1_offset_it = alloc.spill_offset.find(instr.src1);
-        int src1_offset = src1_offset_it != alloc.spill_offset.end() ? src1_offset_it->second : -1;
+    void generate_instruction(const TacInstr& instr, const InstrAlloc& alloc) {
+        // Handle labels
+        if (instr.op == TacOp::LABEL) {
+            output_ += instr.src2 + ":\n";
+            emit_reloads(alloc);
+            return;
+        }
+        emit_reloads(alloc);
 
         switch (instr.op) {
-            case TacOp::LOAD_IMM:
-                if (is_number(instr.src1)) {
-                    output_ += "\tli " + dest_reg + ", " + instr.src1 + "\n";
-                } else if (src1_offset >= 0) {
-                    output_ += "\tlw " + dest_reg + ", " + std::to_string(src1_offset) + "(s0)\n";
-                } else {
-                    output_ += "\taddi " + dest_reg + ", " + src1_reg + ", 0\n";
-                }
+            case TacOp::LOAD_IMM: {
+                // Recomputed at every use instead
+                if (!alloc.reg_map.count(instr.dest) && alloc.remat.count(instr.dest)) break;
+                std::string rd = dest_reg(instr.dest, alloc, "t0");
+                output_ += "\tli " + rd + ", " + instr.src1 + "\n";
+                store_dest(instr.dest, alloc, rd);
                 break;
+            }
 
             case TacOp::ADD:
-                if (is_number(instr.src2)) {
-                    output_ += "\taddi " + dest_reg + ", " + src1_reg + ", " + instr.src2 + "\n";
-                } else {
-                    output_ += "\tadd " + dest_reg + ", " + src1_reg + ", " + src2_reg + "\n";
-                }
-                break;
-
             case TacOp::SUB:
-                if (is_number(instr.src2)) {
-                    output_ += "\taddi " + dest_reg + ", " + src1_reg + ", -" + instr.src2 + "\n";
-                } else {
-                    output_ += "\tsub " + dest_reg + ", " + src1_reg + ", " + src2_reg + "\n";
-                }
-                break;
-
             case TacOp::MUL:
-                output_ += "\tmul " + dest_reg + ", " + src1_reg + ", " + src2_reg + "\n";
-                break;
-
             case TacOp::DIV:
-                output_ += "\tdiv " + dest_reg + ", " + src1_reg + ", " + src2_reg + "\n";
-                break;
-
-            case TacOp::MOD:
-                output_ += "\trem " + dest_reg + ", " + src1_reg + ", " + src2_reg + "\n";
+            case TacOp::MOD: {
+                if ((instr.op == TacOp::DIV || instr.op == TacOp::MOD) && is_number(instr.src2) &&
+                    instr.src2 != "0") {
+                    emit_divide_by_constant(instr, alloc);
+                    break;
+                }
+                if (instr.op == TacOp::MUL && is_number(instr.src2) &&
+                    has_immediate_form(instr.op, std::stoll(instr.src2))) {
+                    emit_multiply_by_constant(instr, alloc);
+                    break;
+                }
+                std::string rs1 = src_reg(instr.src1, alloc, "t0");
+                std::string rd = dest_reg(instr.dest, alloc, "t0");
+                long long imm = 0;
+                bool use_imm = is_number(instr.src2) &&
+                               (instr.op == TacOp::ADD || instr.op == TacOp::SUB);
+                if (use_imm) {
+                    imm = std::stoll(instr.src2);
+                    if (instr.op == TacOp::SUB) imm = -imm;
+                    use_imm = fits_imm12(imm);
+                }
+                if (use_imm) {
+                    output_ += "\taddi " + rd + ", " + rs1 + ", " + std::to_string(imm) + "\n";
+                } else {
+                    static const char* names[] = {"add", "sub", "mul", "div", "rem"};
+                    std::string rs2 = src_reg(instr.src2, alloc, "t1");
+                    output_ += std::string("\t") + names[static_cast<int>(instr.op)] + " " +
+                               rd + ", " + rs1 + ", " + rs2 + "\n";
+                }
+                store_dest(instr.dest, alloc, rd);
                 break;
+            }
 
             case TacOp::EQ:
             case TacOp::NE:
@@ -138,92 +675,93 @@ private:
             case TacOp::LE:
             case TacOp::GE: {
                 // Compare and set dest to 0 or 1
-                std::string cmpInstr = "";
-                std::string resultInstr = "";  // Instruction to convert result (seqz/snez)
-                bool isImm = is_number(instr.src2);
-
-                if (instr.op == TacOp::EQ) {
-                    cmpInstr = isImm ? "xori" : "sub";
+                if (is_number(instr.src2) && has_immediate_form(instr.op, std::stoll(instr.src2))) {
+                    emit_compare_immediate(instr, alloc);
+                    break;
                 }
-                else if (instr.op == TacOp::NE) {
-                    cmpInstr = isImm ? "xori" : "sub";
-                    resultInstr = "seqz";  // NE: result is 1 if xori result is 0
-                }
-                else if (instr.op == TacOp::LT) {
-                    cmpInstr = "slt";
-                }
-                else if (instr.op == TacOp::GE) {
-                    cmpInstr = "slt";
-                    resultInstr = "seqz";  // GE: result is 1 if slt result is 0
-                }
-                else if (instr.op == TacOp::LE) {
-                    cmpInstr = "slt";
-                    std::swap(src1_reg, src2_reg);  // LE: a <= b is b < a
-                }
-                else if (instr.op == TacOp::GT) {
-                    cmpInstr = "slt";
-                    std::swap(src1_reg, src2_reg);  // GT: a > b is b < a
-                    resultInstr = "seqz";  // GT: result is 1 if slt result is 0
+                std::string rs1 = src_reg(instr.src1, alloc, "t0");
+                std::string rs2 = src_reg(instr.src2, alloc, "t1");
+                std::string rd = dest_reg(instr.dest, alloc, "t0");
+
+                if (instr.op == TacOp::EQ || instr.op == TacOp::NE) {
+                    // Equal values leave a zero difference
+                    output_ += "\tsub " + rd + ", " + rs1 + ", " + rs2 + "\n";
+                    output_ += std::string("\t") + (instr.op == TacOp::EQ ? "seqz " : "snez ") +
+                               rd + ", " + rd + "\n";
+                } else {
+                    // a > b and a <= b compare b < a; GE and LE invert the result
+                    if (instr.op == TacOp::GT || instr.op == TacOp::LE) {
+                        std::swap(rs1, rs2);
+                    }
+                    output_ += "\tslt " + rd + ", " + rs1 + ", " + rs2 + "\n";
+                    if (instr.op == TacOp::GE || instr.op == TacOp::LE) {
+                        output_ += "\txori " + rd + ", " + rd + ", 1\n";
+                    }
                 }
+                store_dest(instr.dest, alloc, rd);
+                break;
+            }
 
-                if (isImm && (instr.op == TacOp::EQ || instr.op == TacOp::NE)) {
-                    // For EQ/NE with immediate, use xori
-                    output_ += "\t" + cmpInstr + " " + dest_reg + ", " + src1_reg + ", " + instr.src2 + "\n";
-                    if (!resultInstr.empty()) {
-                        output_ += "\t" + resultInstr + " " + dest_reg + ", " + dest_reg + "\n";
+            case TacOp::AND:
+            case TacOp::OR: {
+                // Logical and/or of two truth values
+                if (is_number(instr.src2)) {
+                    // x && 0 and x || 1 are constant; x && 1 and x || 0 are x != 0
+                    bool truth = std::stoll(instr.src2) != 0;
+                    std::string rd = dest_reg(instr.dest, alloc, "t0");
+                    if (truth == (instr.op == TacOp::AND)) {
+                        output_ += "\tsnez " + rd + ", " + src_reg(instr.src1, alloc, "t0") + "\n";
+                    } else {
+                        output_ += std::string("\tli ") + rd + ", " + (truth ? "1" : "0") + "\n";
                     }
-                } else if (!resultInstr.empty()) {
-                    // For comparisons that need result inversion (NE, GT, GE with registers)
-                    output_ += "\t" + cmpInstr + " " + dest_reg + ", " + src1_reg + ", " + src2_reg + "\n";
-                    output_ += "\t" + resultInstr + " " + dest_reg + ", " + dest_reg + "\n";
-                } else {
-                    // LT, LE, EQ with registers - no inversion needed
-                    output_ += "\t" + cmpInstr + " " + dest_reg + ", " + src1_reg + ", " + src2_reg + "\n";
+                    store_dest(instr.dest, alloc, rd);
+                    break;
                 }
+                std::string rs1 = src_reg(instr.src1, alloc, "t0");
+                std::string rs2 = src_reg(instr.src2, alloc, "t1");
+                std::string rd = dest_reg(instr.dest, alloc, "t0");
+                output_ += "\tsnez t0, " + rs1 + "\n";
+                output_ += "\tsnez t1, " + rs2 + "\n";
+                output_ += std::string("\t") + (instr.op == TacOp::AND ? "and " : "or ") +
+                           rd + ", t0, t1\n";
+                store_dest(instr.dest, alloc, rd);
+                break;
+            }
+
+            case TacOp::NOT: {
+                std::string rs1 = src_reg(instr.src1, alloc, "t0");
+                std::string rd = dest_reg(instr.dest, alloc, "t0");
+                output_ += "\tseqz " + rd + ", " + rs1 + "\n";
+                store_dest(instr.dest, alloc, rd);
                 break;
             }
 
             case TacOp::LOAD:
-                if (src1_offset >= 0) {
-                    output_ += "\tlw " + dest_reg + ", " + std::to_string(src1_offset) + "(s0)\n";
+                if (!instr.src1.empty() && instr.src1[0] == '#') {
+                    // Stack-passed argument: "#s0:<offset>" from the caller's sp
+                    std::string rd = dest_reg(instr.dest, alloc, "t0");
+                    int offset = frame_.incoming_arg(std::stoi(instr.src1.substr(4)));
+                    output_ += "\tlw " + rd + ", " + frame_slot(offset, rd) + "\n";
+                    store_dest(instr.dest, alloc, rd);
+                } else {
+                    // Named slots live in registers (or spill slots) like any other value
+                    emit_copy(instr.dest, instr.src1, alloc);
                 }
                 break;
 
+            case TacOp::STORE:
+                emit_copy(instr.dest, instr.src1, alloc);
+                break;
+
             case TacOp::LOAD_PARAM:
                 // Load parameter from argument register (a0-a7) to destination
                 // src1 = register name (e.g., "a0", "a1"), dest = temp variable
-                if (!instr.src1.empty()) {
-                    output_ += "\taddi " + dest_reg + ", " + instr.src1 + ", 0\n";
-                }
-                break;
-
-            case TacOp::STORE:
-                if (dest_offset >= 0) {
-                    if (is_number(instr.src1)) {
-                        output_ += "\tli t0, " + instr.src1 + "\n";
-                        output_ += "\tsw t0, " + std::to_string(dest_offset) + "(s0)\n";
-                    } else if (src1_offset >= 0) {
-                        output_ += "\tlw t0, " + std::to_string(src1_offset) + "(s0)\n";
-                        output_ += "\tsw t0, " + std::to_string(dest_offset) + "(s0)\n";
-                    } else {
-                        output_ += "\tsw " + src1_reg + ", " + std::to_string(dest_offset) + "(s0)\n";
-                    }
-                }
+                emit_copy(instr.dest, instr.src1, alloc);
                 break;
 
             case TacOp::BEQZ:
             case TacOp::BNEZ: {
-                std::string condReg;
-                if (is_number(instr.src1)) {
-                    output_ += "\tli t0, " + instr.src1 + "\n";
-                    condReg = "t0";
-                } else if (src1_offset >= 0) {
-                    output_ += "\tlw t0, " + std::to_string(src1_offset) + "(s0)\n";
-                    condReg = "t0";
-                } else {
-                    condReg = src1_reg;
-                }
-
+                std::string condReg = src_reg(instr.src1, alloc, "t0");
                 std::string jumpLabel = instr.src2;  // Label is in src2 for BEQZ/BNEZ
                 if (instr.op == TacOp::BEQZ) {
                     output_ += "\tbeqz " + condReg + ", " + jumpLabel + "\n";
@@ -238,67 +776,42 @@ private:
                 break;
 
             case TacOp::RET:
-                if (!instr.src1.empty()) {
-                    if (is_number(instr.src1)) {
-                        output_ += "\tli a0, " + instr.src1 + "\n";
-                    } else {
-                        auto src1_offset_it = alloc.spill_offset.find(instr.src1);
-                        int src1_offset = src1_offset_it != alloc.spill_offset.end() ? src1_offset_it->second : -1;
-                        if (src1_offset >= 0) {
-                            output_ += "\tlw a0, " + std::to_string(src1_offset) + "(s0)\n";
-                        } else {
-                            auto it = alloc.reg_map.find(instr.src1);
-                            std::string src_reg = it != alloc.reg_map.end() ? it->second : "";
-                            output_ += "\taddi a0, " + src_reg + ", 0\n";
-                        }
-                    }
+                // The return value is already in a0 (MOVE a0, value)
+                if (frame_.size == 0) {
+                    output_ += "\tret\n";
+                } else {
+                    output_ += "\tj epilogue_" + current_func_->name + "\n";
                 }
                 break;
 
-            case TacOp::PHI:
-                // PHI nodes are handled during SSA transformation
+            case TacOp::MOVE:
+                // dest may be a physical register (e.g., "a0" for return value)
+                emit_copy(instr.dest, instr.src1, alloc);
                 break;
 
-            case TacOp::MOVE: {
-                // Move src1 to dest
-                // dest = destination register (e.g., "a0" for return value)
-                // src1 = source value
-                if (is_number(instr.src1)) {
-                    output_ += "\tli " + instr.dest + ", " + instr.src1 + "\n";
-                } else {
-                    auto it = alloc.reg_map.find(instr.src1);
-                    std::string src_reg = it != alloc.reg_map.end() ? it->second : "";
-                    output_ += "\taddi " + instr.dest + ", " + src_reg + ", 0\n";
-                }
-                break;
-            }
-
-            case TacOp::PARAM: {
+            case TacOp::PARAM:
                 // Load argument into specified register (a0, a1, etc.)
-                // dest = register name (a0, a1, etc.)
-                // src1 = argument value
-                if (is_number(instr.src1)) {
-                    output_ += "\tli " + instr.dest + ", " + instr.src1 + "\n";
-                } else {
-                    auto it = alloc.reg_map.find(instr.src1);
-                    std::string src_reg = it != alloc.reg_map.end() ? it->second : "";
-                    output_ += "\taddi " + instr.dest + ", " + src_reg + ", 0\n";
-                }
+                // dest = register name (a0, a1, etc.), src1 = argument value
+                emit_copy(instr.dest, instr.src1, alloc);
                 break;
-            }
 
             case TacOp::CALL: {
                 // Function name is in src1 for CALL
                 // Arguments are already loaded via PARAM instructions
+                // Caller-saved registers holding values still needed afterwards
+                // are kept in the frame across the call
+                const auto& saved = alloc.caller_saved;
+                for (size_t k = 0; k < saved.size(); k++) {
+                    output_ += "\tsw " + saved[k] + ", " + frame_slot(frame_.caller_save_base + 4 * k, "t0") + "\n";
+                }
                 output_ += "\tcall " + instr.src1 + "\n";
+                for (size_t k = 0; k < saved.size(); k++) {
+                    output_ += "\tlw " + saved[k] + ", " + frame_slot(frame_.caller_save_base + 4 * k, "t0") + "\n";
+                }
 
                 // Move return value to destination
                 if (!instr.dest.empty()) {
-                    if (dest_offset >= 0) {
-                        output_ += "\tsw a0, " + std::to_string(dest_offset) + "(s0)\n";
-                    } else {
-                        output_ += "\taddi " + dest_reg + ", a0, 0\n";
-                    }
+                    emit_copy(instr.dest, "a0", alloc);
                 }
                 break;
             }
@@ -308,6 +821,228 @@ private:
         }
     }
 
+    // One step of a multiply-by-constant chain: shift the running product
+    // left, add or subtract the multiplicand, or negate the product.
+    struct MulStep {
+        char op;  // '<' slli, '+' add x, '-' sub x, 'n' neg
+        int shift;
+    };
+
+    // Horner chain over the signed-digit (non-adjacent) form of c: with the
+    // non-zero digits d_i at bit positions p_n > ... > p_0 and d_n = 1,
+    //     x * c = ((x << (p_n - p_{n-1})) +- x) << ... +- x) << p_0
+    // so runs of ones cost one subtract instead of an add per bit. The form
+    // of -c followed by a negation is used when it is shorter. Products wrap
+    // like mul, so digits at bit 32 and up are dropped. An empty chain
+    // means x itself; c must not be 0.
+    static std::vector<MulStep> multiply_chain(int32_t c) {
+        auto horner = [](uint32_t value, std::vector<MulStep>& steps) {
+            std::vector<std::pair<int, int>> digits;  // (position, +-1), lowest first
+            uint64_t n = value;
+            for (int pos = 0; n != 0 && pos < 32; pos++, n >>= 1) {
+                if (!(n & 1)) continue;
+                int digit = (n & 3) == 1 ? 1 : -1;
+                n -= digit;
+                digits.push_back({pos, digit});
+            }
+            if (digits.empty() || digits.back().second != 1) return false;
+            for (size_t i = digits.size() - 1; i > 0; i--) {
+                steps.push_back({'<', digits[i].first - digits[i - 1].first});
+                steps.push_back({digits[i - 1].second > 0 ? '+' : '-', 0});
+            }
+            if (digits[0].first > 0) steps.push_back({'<', digits[0].first});
+            return true;
+        };
+        std::vector<MulStep> direct, negated;
+        bool has_direct = horner((uint32_t)c, direct);
+        bool has_negated = horner(0u - (uint32_t)c, negated);
+        negated.push_back({'n', 0});
+        if (!has_direct || (has_negated && negated.size() < direct.size())) return negated;
+        return direct;
+    }
+
+    // MUL by a literal as the shift/add chain of multiply_chain. The product
+    // builds up in t1 and only the last step writes rd, so rd may be the
+    // multiplicand's register.
+    void emit_multiply_by_constant(const TacInstr& instr, const InstrAlloc& alloc) {
+        int32_t c = (int32_t)std::stoll(instr.src2);
+        std::string rs = src_reg(instr.src1, alloc, "t0");
+        std::string rd = dest_reg(instr.dest, alloc, "t0");
+        if (c == 0) {
+            output_ += "\tli " + rd + ", 0\n";
+            store_dest(instr.dest, alloc, rd);
+            return;
+        }
+        std::vector<MulStep> steps = multiply_chain(c);
+        if (steps.empty()) output_ += "\taddi " + rd + ", " + rs + ", 0\n";
+        std::string product = rs;
+        for (size_t i = 0; i < steps.size(); i++) {
+            std::string target = i + 1 == steps.size() ? rd : "t1";
+            switch (steps[i].op) {
+                case '<':
+                    output_ += "\tslli " + target + ", " + product + ", " + std::to_string(steps[i].shift) + "\n";
+                    break;
+                case '+':
+                    output_ += "\tadd " + target + ", " + product + ", " + rs + "\n";
+                    break;
+                case '-':
+                    output_ += "\tsub " + target + ", " + product + ", " + rs + "\n";
+                    break;
+                default:
+                    output_ += "\tsub " + target + ", zero, " + product + "\n";
+                    break;
+            }
+            product = target;
+        }
+        store_dest(instr.dest, alloc, rd);
+    }
+
+    // Magic multiplier and shift for signed division by d, |d| >= 2 and not
+    // a power of two (Granlund-Montgomery, in the form of Hacker's Delight
+    // 10-1): n / d = mulh(n, magic) (+ n if d > 0 and magic < 0, - n if
+    // d < 0 and magic > 0) >> shift, plus one when that is negative.
+    static void division_magic(int32_t d, int32_t& magic, int& shift) {
+        const uint32_t two31 = 0x80000000u;
+        uint32_t ad = d < 0 ? 0u - (uint32_t)d : (uint32_t)d;
+        uint32_t t = two31 + ((uint32_t)d >> 31);
+        uint32_t anc = t - 1 - t % ad;  // |nc|
+        int p = 31;
+        uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+        uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+        uint32_t delta;
+        do {
+            p++;
+            q1 *= 2;
+            r1 *= 2;
+            if (r1 >= anc) {
+                q1++;
+                r1 -= anc;
+            }
+            q2 *= 2;
+            r2 *= 2;
+            if (r2 >= ad) {
+                q2++;
+                r2 -= ad;
+            }
+            delta = ad - r2;
+        } while (q1 < delta || (q1 == delta && r1 == 0));
+        magic = (int32_t)(q2 + 1);
+        if (d < 0) magic = -magic;
+        shift = p - 32;
+    }
+
+    // DIV and MOD by a non-zero literal without div/rem, which take tens of
+    // cycles. Quotients round toward zero like div; a remainder is n - q * d,
+    // and keeps the sign of n like rem.
+    //   d = +-1        mv or neg; the remainder is 0
+    //   |d| = 2^k      bias negative n by 2^k - 1, then srai k (quotient)
+    //                  or clear the low k bits and subtract (remainder)
+    //   otherwise      mulh by the magic number, correct, srai, round
+    // Only t0 and t1 are needed besides rd; a spilled dividend held in t0 is
+    // loaded again when the remainder needs it after t0 was reused.
+    void emit_divide_by_constant(const TacInstr& instr, const InstrAlloc& alloc) {
+        int32_t d = (int32_t)std::stoll(instr.src2);
+        bool remainder = instr.op == TacOp::MOD;
+        uint32_t ad = d < 0 ? 0u - (uint32_t)d : (uint32_t)d;
+        std::string rs = src_reg(instr.src1, alloc, "t0");
+        std::string rd = dest_reg(instr.dest, alloc, "t0");
+
+        if (ad == 1) {
+            if (remainder) {
+                output_ += "\tli " + rd + ", 0\n";
+            } else {
+                output_ += std::string("\t") + (d < 0 ? "sub " + rd + ", zero, " : "addi " + rd + ", ") + rs +
+                           (d < 0 ? "" : ", 0") + "\n";
+            }
+            store_dest(instr.dest, alloc, rd);
+            return;
+        }
+
+        if ((ad & (ad - 1)) == 0) {
+            int k = 0;
+            while ((1u << k) != ad) k++;
+            // t1 = n + (n < 0 ? 2^k - 1 : 0)
+            if (k == 1) {
+                output_ += "\tsrli t1, " + rs + ", 31\n";
+            } else {
+                output_ += "\tsrai t1, " + rs + ", 31\n";
+                output_ += "\tsrli t1, t1, " + std::to_string(32 - k) + "\n";
+            }
+            output_ += "\tadd t1, " + rs + ", t1\n";
+            if (remainder) {
+                if (k <= 11) {
+                    output_ += "\tandi t1, t1, " + std::to_string(-(1 << k)) + "\n";
+                } else {
+                    output_ += "\tsrai t1, t1, " + std::to_string(k) + "\n";
+                    output_ += "\tslli t1, t1, " + std::to_string(k) + "\n";
+                }
+                output_ += "\tsub " + rd + ", " + rs + ", t1\n";
+            } else {
+                output_ += "\tsrai " + rd + ", t1, " + std::to_string(k) + "\n";
+                if (d < 0) output_ += "\tsub " + rd + ", zero, " + rd + "\n";
+            }
+            store_dest(instr.dest, alloc, rd);
+            return;
+        }
+
+        int32_t magic;
+        int shift;
+        division_magic(d, magic, shift);
+        output_ += "\tli t1, " + std::to_string(magic) + "\n";
+        output_ += "\tmulh t1, " + rs + ", t1\n";
+        if (d > 0 && magic < 0) output_ += "\tadd t1, t1, " + rs + "\n";
+        if (d < 0 && magic > 0) output_ += "\tsub t1, t1, " + rs + "\n";
+        if (shift > 0) output_ += "\tsrai t1, t1, " + std::to_string(shift) + "\n";
+        output_ += "\tsrli t0, t1, 31\n";
+        if (!remainder) {
+            output_ += "\tadd " + rd + ", t1, t0\n";
+        } else {
+            output_ += "\tadd t1, t1, t0\n";
+            output_ += "\tli t0, " + std::to_string(d) + "\n";
+            output_ += "\tmul t1, t1, t0\n";
+            if (rs == "t0") rs = src_reg(instr.src1, alloc, "t0");
+            output_ += "\tsub " + rd + ", " + rs + ", t1\n";
+        }
+        store_dest(instr.dest, alloc, rd);
+    }
+
+    // Branch to the target of `branch` when `cmp` holds (BNEZ) or fails
+    // (BEQZ). a > b and a <= b compare b < a; failing flips blt/bge and beq/bne.
+    void emit_compare_branch(const TacInstr& cmp, const TacInstr& branch, const InstrAlloc& alloc) {
+        std::string rs1 = src_reg(cmp.src1, alloc, "t0");
+        std::string rs2 = src_reg(cmp.src2, alloc, "t1");
+        bool ordered = cmp.op != TacOp::EQ && cmp.op != TacOp::NE;
+        bool holds = cmp.op == TacOp::LT || cmp.op == TacOp::GT || cmp.op == TacOp::EQ;
+        if (cmp.op == TacOp::GT || cmp.op == TacOp::LE) std::swap(rs1, rs2);
+        if (branch.op == TacOp::BEQZ) holds = !holds;
+        const char* name = ordered ? (holds ? "blt" : "bge") : (holds ? "beq" : "bne");
+        output_ += std::string("\t") + name + " " + rs1 + ", " + rs2 + ", " + branch.src2 + "\n";
+    }
+
+    // Comparison against a literal src2 (see has_immediate_form)
+    void emit_compare_immediate(const TacInstr& instr, const InstrAlloc& alloc) {
+        long long value = std::stoll(instr.src2);
+        std::string rs1 = src_reg(instr.src1, alloc, "t0");
+        std::string rd = dest_reg(instr.dest, alloc, "t0");
+        if (instr.op == TacOp::EQ || instr.op == TacOp::NE) {
+            std::string diff = rs1;
+            if (value != 0) {
+                output_ += "\taddi " + rd + ", " + rs1 + ", " + std::to_string(-value) + "\n";
+                diff = rd;
+            }
+            output_ += std::string("\t") + (instr.op == TacOp::EQ ? "seqz " : "snez ") +
+                       rd + ", " + diff + "\n";
+        } else {
+            // x <= c is x < c + 1; GE and GT invert the result
+            if (instr.op == TacOp::LE || instr.op == TacOp::GT) value++;
+            output_ += "\tslti " + rd + ", " + rs1 + ", " + std::to_string(value) + "\n";
+            if (instr.op == TacOp::GE || instr.op == TacOp::GT) {
+                output_ += "\txori " + rd + ", " + rd + ", 1\n";
+            }
+        }
+        store_dest(instr.dest, alloc, rd);
+    }
+
     bool is_number(const std::string& s) const {
         if (s.empty()) return false;
         size_t i = 0;
@@ -321,7 +1056,8 @@ private:
         return !s.empty() && (s[0] != '-' || s.size() > 1);
     }
 
-    // Simple peephole optimizer - removes redundant mv/addi instructions
+    // Simple peephole optimizer - removes moves of a register onto itself and
+    // jumps to the label that immediately follows
     std::string optimize_peephole_simple(const std::string& code) {
         std::vector<std::string> lines;
         std::stringstream ss(code);
@@ -330,166 +1066,23 @@ private:
             lines.push_back(line);
         }
 
-        // Track register equivalence: reg_equiv[reg] = parent_reg
-        // If reg_equiv[reg] = parent, it means reg is an alias for parent
-        std::unordered_map<std::string, std::string> reg_equiv;
-
-        // Track value origin: value_origin[reg] = original_reg_that_holds_the_value
-        // Keyed by the ORIGINAL register name, not the alias
-        std::unordered_map<std::string, std::string> value_origin;
-
-        // Find the ultimate source of a register (follow alias chain)
-        auto find_alias = [&](const std::string& reg, auto&& find_ref) -> std::string {
-            if (reg_equiv.find(reg) == reg_equiv.end()) {
-                return reg;
-            }
-            std::string src = find_ref(reg_equiv[reg], find_ref);
-            reg_equiv[reg] = src;  // Path compression
-            return src;
-        };
-
-        // Find the original source of a register's value
-        // Follows alias chain to find the ultimate register, then looks up its origin
-        auto find_origin = [&](const std::string& reg) -> std::string {
-            // First, find the ultimate alias by following the chain without path compression
-            std::string alias = reg;
-            std::string current = reg;
-            while (reg_equiv.find(current) != reg_equiv.end()) {
-                current = reg_equiv[current];
-            }
-            alias = current;
-            // Look up origin using the alias
-            if (value_origin.find(alias) != value_origin.end()) {
-                return value_origin[alias];
-            }
-            // If no origin, return the final alias
-            return alias;
-        };
-
-        // Make dest an alias of src
-        auto make_alias = [&](const std::string& dest, const std::string& src) {
-            std::string dest_alias = find_alias(dest, find_alias);
-            std::string src_alias = find_alias(src, find_alias);
-
-            if (dest_alias != src_alias) {
-                // Different aliases: link dest_alias to src_alias
-                reg_equiv[dest_alias] = src_alias;
-            }
-            // Set origin for the ORIGINAL dest to track where its value came from
-            if (value_origin.find(dest) == value_origin.end() || dest_alias != dest) {
-                // Find the ultimate alias of src WITHOUT path compression
-                std::string src_origin = src;
-                std::string current = src;
-                while (reg_equiv.find(current) != reg_equiv.end()) {
-                    current = reg_equiv[current];
-                }
-                src_origin = current;
-                // But if src has an origin, use that instead
-                if (value_origin.find(src) != value_origin.end()) {
-                    src_origin = value_origin[src];
-                }
-                value_origin[dest] = src_origin;
-            }
-        };
-
-        // Set a register's value origin (called for li, arithmetic, etc.)
-        auto set_origin = [&](const std::string& reg, const std::string& origin) {
-            value_origin[reg] = origin;
-        };
-
-        // First pass: build equivalence and origin tracking
+        std::vector<std::string> result;
         for (size_t i = 0; i < lines.size(); i++) {
-            std::string& current = lines[i];
-
-            // Skip labels and empty lines (after trimming whitespace)
-            std::string trimmed = current;
-            trimmed.erase(0, trimmed.find_first_not_of(" \t"));
-            if (trimmed.empty() || trimmed.back() == ':') {
+            std::stringstream ss2(lines[i]);
+            std::string instr, dest, src, imm;
+            ss2 >> instr >> dest >> src >> imm;
+            dest.erase(std::remove(dest.begin(), dest.end(), ','), dest.end());
+            src.erase(std::remove(src.begin(), src.end(), ','), src.end());
+
+            // addi x, x, 0
+            if (instr == "addi" && dest == src && imm == "0") {
                 continue;
             }
-
-            std::string instr;
-            std::stringstream ss2(current);
-            ss2 >> instr;
-
-            if (instr == "li") {
-                std::string reg, imm;
-                ss2 >> reg >> imm;
-                reg.erase(std::remove(reg.begin(), reg.end(), ','), reg.end());
-                set_origin(reg, reg);
-            }
-            else if (instr == "add" || instr == "sub" || instr == "mul" ||
-                     instr == "div" || instr == "rem" || instr == "slt" ||
-                     instr == "sgt" || instr == "and" || instr == "or") {
-                std::string dest;
-                ss2 >> dest;
-                dest.erase(std::remove(dest.begin(), dest.end(), ','), dest.end());
-                reg_equiv.erase(dest);
-                set_origin(dest, dest);
-            }
-            else if (instr == "addi") {
-                std::string dest, src, imm;
-                ss2 >> dest >> src >> imm;
-                dest.erase(std::remove(dest.begin(), dest.end(), ','), dest.end());
-                src.erase(std::remove(src.begin(), src.end(), ','), src.end());
-                imm.erase(std::remove(imm.begin(), imm.end(), ','), imm.end());
-
-                if (imm == "0" && dest != src) {
-                    make_alias(dest, src);
-                } else {
-                    reg_equiv.erase(dest);
-                    set_origin(dest, dest);
-                }
-            }
-            else if (instr == "xori" || instr == "seqz" || instr == "snez" ||
-                     instr == "lui" || instr == "lw") {
-                std::string reg;
-                ss2 >> reg;
-                reg.erase(std::remove(reg.begin(), reg.end(), ','), reg.end());
-                reg_equiv.erase(reg);
-                set_origin(reg, reg);
-            }
-        }
-
-        // Second pass: remove redundant instructions based on origin tracking
-        for (size_t i = 0; i < lines.size(); i++) {
-            std::string& current = lines[i];
-            std::string trimmed = current;
-            trimmed.erase(0, trimmed.find_first_not_of(" \t"));
-            if (trimmed.empty() || trimmed.back() == ':') continue;
-
-            std::stringstream ss2(current);
-            std::string instr;
-            ss2 >> instr;
-
-            if (instr == "addi") {
-                std::string dest, src, imm;
-                ss2 >> dest >> src >> imm;
-                dest.erase(std::remove(dest.begin(), dest.end(), ','), dest.end());
-                src.erase(std::remove(src.begin(), src.end(), ','), src.end());
-                imm.erase(std::remove(imm.begin(), imm.end(), ','), imm.end());
-
-                if (imm == "0") {
-                    // Don't remove addi to a0 - it's needed for return value
-                    if (dest == "a0") {
-                        continue;
-                    }
-                    std::string origin_dest = find_origin(dest);
-                    std::string origin_src = find_origin(src);
-
-                    if (origin_dest == origin_src) {
-                        lines[i] = "";
-                    }
-                }
-            }
-        }
-
-        // Remove empty lines
-        std::vector<std::string> result;
-        for (const auto& l : lines) {
-            if (!l.empty()) {
-                result.push_back(l);
+            // j L immediately followed by L:
+            if (instr == "j" && i + 1 < lines.size() && lines[i + 1] == dest + ":") {
+                continue;
             }
+            result.push_back(lines[i]);
         }
 
         // Reconstruct
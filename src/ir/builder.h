@@ -26,6 +26,13 @@ public:
             auto func_ir = std::make_unique<FunctionIR>();
             func_ir->name = func->func_name;
             func_ir->is_void = (func->return_type == "void");
+            for (auto &param : func->params)
+            {
+                if (param->type == NodeType::Param)
+                {
+                    func_ir->params.push_back(static_cast<Param *>(param.get())->param_name);
+                }
+            }
             program_ir_->functions.push_back(std::move(func_ir));
         }
 
@@ -87,9 +94,10 @@ private:
                     std::string arg_reg = "a" + std::to_string(param_idx);
                     emit(TacOp::LOAD_PARAM, result, arg_reg, "");
                 } else {
-                    // For args >= 8, load from stack offset using s0 (caller's sp)
-                    // Prologue saves caller's sp in s0 before frame adjustment
-                    // Extra args are stored at s0+0, s0+4, etc. (call pushes ra at s0+8)
+                    // For args >= 8, load from the stack: "#s0:<offset>" is relative
+                    // to sp on entry (the caller's sp), where the caller stored
+                    // the extra args at offsets 0, 4, ...; the backend resolves it
+                    // against its frame layout
                     int offset = (param_idx - 8) * 4;
                     emit(TacOp::LOAD, result, "#s0:" + std::to_string(offset), "");
                 }
@@ -214,20 +222,19 @@ private:
 
     void build_if(IfStmt *stmt)
     {
-        std::string cond = build_expr(stmt->cond.get());
         std::string end_label = current_func_->next_label();
 
         if (stmt->else_stmt) {
             // if ... else ...: need else_label
             std::string else_label = current_func_->next_label();
-            emit(TacOp::BEQZ, "", cond, else_label);
+            build_cond(stmt->cond.get(), "", else_label);
             build_stmt(stmt->then_stmt.get());
             emit(TacOp::JUMP, "", "", end_label);
             emit(TacOp::LABEL, "", "", else_label);
             build_stmt(stmt->else_stmt.get());
         } else {
             // if ... without else: jump to end if condition is false
-            emit(TacOp::BEQZ, "", cond, end_label);
+            build_cond(stmt->cond.get(), "", end_label);
             build_stmt(stmt->then_stmt.get());
             // No need to jump to end - just fall through
         }
@@ -244,8 +251,7 @@ private:
         loop_labels_stack_.push(labels);
 
         emit(TacOp::LABEL, "", "", loop_start);
-        std::string cond = build_expr(stmt->cond.get());
-        emit(TacOp::BEQZ, "", cond, loop_end);
+        build_cond(stmt->cond.get(), "", loop_end);
         build_stmt(stmt->body.get());
         emit(TacOp::JUMP, "", "", loop_start);
         emit(TacOp::LABEL, "", "", loop_end);
@@ -285,6 +291,64 @@ private:
         emit(TacOp::RET, "", "", "");
     }
 
+    // Branch on a condition: jump to true_label when expr is non-zero and to
+    // false_label when it is zero; an empty label means falling through.
+    // && and || jump straight to their targets instead of computing 0/1,
+    // ! swaps the targets, and constants become a JUMP or nothing. A
+    // comparison still produces a temp for the BEQZ/BNEZ, which the code
+    // generator fuses into one compare-and-branch.
+    void build_cond(ExprNode *expr, const std::string &true_label, const std::string &false_label)
+    {
+        if (expr->type == NodeType::BinaryExpr)
+        {
+            auto e = static_cast<BinaryExpr *>(expr);
+            if (e->op == OpType::And)
+            {
+                // left false: the whole condition is false
+                std::string skip = false_label.empty() ? current_func_->next_label() : false_label;
+                build_cond(e->left.get(), "", skip);
+                build_cond(e->right.get(), true_label, false_label);
+                if (false_label.empty())
+                    emit(TacOp::LABEL, "", "", skip);
+                return;
+            }
+            if (e->op == OpType::Or)
+            {
+                // left true: the whole condition is true
+                std::string skip = true_label.empty() ? current_func_->next_label() : true_label;
+                build_cond(e->left.get(), skip, "");
+                build_cond(e->right.get(), true_label, false_label);
+                if (true_label.empty())
+                    emit(TacOp::LABEL, "", "", skip);
+                return;
+            }
+        }
+        if (expr->type == NodeType::UnaryExpr && static_cast<UnaryExpr *>(expr)->op == OpType::Not)
+        {
+            build_cond(static_cast<UnaryExpr *>(expr)->operand.get(), false_label, true_label);
+            return;
+        }
+        if (expr->type == NodeType::ConstExpr)
+        {
+            const std::string &target = static_cast<ConstExpr *>(expr)->const_value ? true_label : false_label;
+            if (!target.empty())
+                emit(TacOp::JUMP, "", "", target);
+            return;
+        }
+
+        std::string value = build_expr(expr);
+        if (!true_label.empty())
+        {
+            emit(TacOp::BNEZ, "", value, true_label);
+            if (!false_label.empty())
+                emit(TacOp::JUMP, "", "", false_label);
+        }
+        else if (!false_label.empty())
+        {
+            emit(TacOp::BEQZ, "", value, false_label);
+        }
+    }
+
     std::string build_expr(ExprNode *expr)
     {
         switch (expr->type)
@@ -292,6 +356,20 @@ private:
         case NodeType::BinaryExpr:
         {
             auto e = static_cast<BinaryExpr *>(expr);
+            if (e->op == OpType::And || e->op == OpType::Or)
+            {
+                // 0/1 value of a short-circuit condition
+                std::string result = current_func_->next_temp();
+                std::string false_label = current_func_->next_label();
+                std::string end_label = current_func_->next_label();
+                build_cond(expr, "", false_label);
+                emit(TacOp::LOAD_IMM, result, "1", "");
+                emit(TacOp::JUMP, "", "", end_label);
+                emit(TacOp::LABEL, "", "", false_label);
+                emit(TacOp::LOAD_IMM, result, "0", "");
+                emit(TacOp::LABEL, "", "", end_label);
+                return result;
+            }
             std::string left = build_expr(e->left.get());
             std::string right = build_expr(e->right.get());
             std::string result = current_func_->next_temp();
@@ -332,56 +410,6 @@ private:
             case OpType::Ne:
                 op = TacOp::NE;
                 break;
-            case OpType::And:
-            {
-                // Short-circuit AND: evaluate left, if non-zero evaluate right and return it, else return 0
-                std::string left = build_expr(e->left.get());
-                std::string end_label = current_func_->next_label();
-                std::string result = current_func_->next_temp();
-
-                // if left == 0, jump to end with result = 0
-                emit(TacOp::BEQZ, "", left, end_label);
-
-                // left != 0, evaluate right
-                std::string right = build_expr(e->right.get());
-
-                // result = right
-                emit(TacOp::MOVE, result, right, "");
-
-                // Jump to end (skip the "result = 0" code)
-                emit(TacOp::JUMP, "", "", end_label);
-
-                // end_label: result = 0 (left was 0)
-                emit(TacOp::LABEL, "", "", end_label);
-                emit(TacOp::LOAD_IMM, result, "0", "");
-
-                return result;
-            }
-            case OpType::Or:
-            {
-                // Short-circuit OR: evaluate left, if non-zero return it, else evaluate right and return it
-                std::string left = build_expr(e->left.get());
-                std::string end_label = current_func_->next_label();
-                std::string result = current_func_->next_temp();
-
-                // if left != 0, jump to end with result = left
-                emit(TacOp::BNEZ, "", left, end_label);
-
-                // left == 0, evaluate right
-                std::string right = build_expr(e->right.get());
-
-                // result = right
-                emit(TacOp::MOVE, result, right, "");
-
-                // Jump to end
-                emit(TacOp::JUMP, "", "", end_label);
-
-                // end_label: result = left (left was non-zero)
-                emit(TacOp::LABEL, "", "", end_label);
-                emit(TacOp::MOVE, result, left, "");
-
-                return result;
-            }
             default:
                 op = TacOp::ADD;
                 break;
@@ -393,6 +421,8 @@ private:
         {
             auto e = static_cast<UnaryExpr *>(expr);
             std::string operand = build_expr(e->operand.get());
+            if (e->op == OpType::Pos)
+                return operand;
             std::string result = current_func_->next_temp();
 
             if (e->op == OpType::Neg)
@@ -4,6 +4,7 @@
 #include "tac.h"
 #include <unordered_map>
 #include <unordered_set>
+#include <algorithm>
 
 // Helper: Check if a string is a temporary variable
 inline bool is_temp(const std::string& s) {
@@ -48,6 +49,80 @@ inline bool is_number(const std::string& s) {
     return !s.empty() && (s[0] != '-' || s.size() > 1);
 }
 
+// Helper: Check if an operand names a variable (not a literal, register or stack slot)
+inline bool is_variable(const std::string& s) {
+    return !s.empty() && !is_number(s) && s[0] != '#' && !is_physical_reg(s);
+}
+
+// Helper: Check if an instruction ends a basic block
+inline bool is_terminator(TacOp op) {
+    return op == TacOp::JUMP || op == TacOp::BEQZ || op == TacOp::BNEZ || op == TacOp::RET;
+}
+
+// Helper: Get the label an instruction refers to (labels live in src2)
+inline const std::string& branch_target(const TacInstr& instr) {
+    return instr.src2;
+}
+
+// Helper: Get pointers to the operand fields an instruction reads
+inline std::vector<std::string*> instr_use_slots(TacInstr& instr) {
+    std::vector<std::string*> slots;
+    switch (instr.op) {
+        case TacOp::ADD:
+        case TacOp::SUB:
+        case TacOp::MUL:
+        case TacOp::DIV:
+        case TacOp::MOD:
+        case TacOp::AND:
+        case TacOp::OR:
+        case TacOp::LT:
+        case TacOp::GT:
+        case TacOp::LE:
+        case TacOp::GE:
+        case TacOp::EQ:
+        case TacOp::NE:
+            slots.push_back(&instr.src1);
+            slots.push_back(&instr.src2);
+            break;
+        case TacOp::NOT:
+        case TacOp::LOAD:
+        case TacOp::LOAD_PARAM:
+        case TacOp::MOVE:
+        case TacOp::STORE:
+        case TacOp::PARAM:
+        case TacOp::BEQZ:
+        case TacOp::BNEZ:
+            slots.push_back(&instr.src1);
+            break;
+        case TacOp::PHI:
+            for (auto& arg : instr.phi_args) slots.push_back(&arg.second);
+            break;
+        default:
+            break;
+    }
+    return slots;
+}
+
+inline std::vector<const std::string*> instr_use_slots(const TacInstr& instr) {
+    std::vector<std::string*> slots = instr_use_slots(const_cast<TacInstr&>(instr));
+    return std::vector<const std::string*>(slots.begin(), slots.end());
+}
+
+// Helper: Check if an instruction writes its dest field
+inline bool instr_has_def(const TacInstr& instr) {
+    switch (instr.op) {
+        case TacOp::LABEL:
+        case TacOp::JUMP:
+        case TacOp::BEQZ:
+        case TacOp::BNEZ:
+        case TacOp::RET:
+        case TacOp::PARAM:
+            return false;
+        default:
+            return !instr.dest.empty();
+    }
+}
+
 // Helper: Get variables used/defined by an instruction
 inline void instr_use_def(const TacInstr& instr,
                           std::unordered_set<std::string>& use,
@@ -77,12 +152,17 @@ inline void instr_use_def(const TacInstr& instr,
 
         // Unary operations: dest = op src1
         case TacOp::NOT:
-        case TacOp::LOAD:
         case TacOp::LOAD_PARAM:
             if (!is_number(instr.src1)) use.insert(instr.src1);
             if (!instr.dest.empty()) def.insert(instr.dest);
             break;
 
+        // Load: dest = var (stack-passed arguments "#s0:off" are not variables)
+        case TacOp::LOAD:
+            if (!is_number(instr.src1) && instr.src1[0] != '#') use.insert(instr.src1);
+            if (!instr.dest.empty()) def.insert(instr.dest);
+            break;
+
         // Move: dest = src1
         case TacOp::MOVE:
             if (!is_number(instr.src1)) use.insert(instr.src1);
@@ -94,14 +174,15 @@ inline void instr_use_def(const TacInstr& instr,
             if (!instr.dest.empty()) def.insert(instr.dest);
             break;
 
-        // Store: mem = src1
+        // Store: var = src1
         case TacOp::STORE:
             if (!is_number(instr.src1)) use.insert(instr.src1);
+            if (!instr.dest.empty()) def.insert(instr.dest);
             break;
 
         // Parameter: param reg = src1
         case TacOp::PARAM:
-            if (!is_number(instr.src2)) use.insert(instr.src2);
+            if (!is_number(instr.src1)) use.insert(instr.src1);
             break;
 
         // Function call: dest = call name
@@ -125,170 +206,247 @@ inline void instr_use_def(const TacInstr& instr,
         case TacOp::RET:
             break;
 
-        // PHI function (for SSA)
+        // PHI function (for SSA): each operand is read on its incoming edge,
+        // so liveness charges it to the predecessor rather than to this block
         case TacOp::PHI:
-            // src1 and src2 are from different predecessors
-            if (!is_number(instr.src1)) use.insert(instr.src1);
-            if (!is_number(instr.src2)) use.insert(instr.src2);
+            for (const auto& arg : instr.phi_args) {
+                if (!is_number(arg.second)) use.insert(arg.second);
+            }
             if (!instr.dest.empty()) def.insert(instr.dest);
             break;
     }
 }
 
+// Helper: Index of the parameter an instruction loads, or -1. IRBuilder loads
+// arguments 0-7 with LOAD_PARAM from a0-a7 and the rest from "#s0:off".
+inline int param_load_index(const TacInstr& instr) {
+    if (instr.op == TacOp::LOAD_PARAM) return std::stoi(instr.src1.substr(1));
+    const std::string prefix = "#s0:";
+    if (instr.op == TacOp::LOAD && instr.src1.compare(0, prefix.size(), prefix) == 0) {
+        return 8 + std::stoi(instr.src1.substr(prefix.size())) / 4;
+    }
+    return -1;
+}
+
+// Helper: Find the argument values of the CALL at instrs[call], i.e. the
+// nearest PARAMs before it, skipping the PARAMs of calls nested in its
+// argument list. positions receives their indices. With same_block the
+// PARAMs must also be in the CALL's basic block.
+inline bool call_arguments(ProgramIR* program, const std::vector<TacInstr>& instrs, int call,
+                           size_t count, std::vector<std::string>& args, std::vector<int>& positions,
+                           bool same_block = true) {
+    args.assign(count, "");
+    positions.clear();
+    std::vector<size_t> pending;  // PARAMs still owed to nested calls
+    for (int j = call - 1; j >= 0 && positions.size() < count; j--) {
+        const TacInstr& instr = instrs[j];
+        if (instr.op == TacOp::CALL) {
+            FunctionIR* nested = program->get_function(instr.src1);
+            if (!nested) return false;
+            if (!nested->params.empty()) pending.push_back(nested->params.size());
+        } else if (instr.op == TacOp::PARAM) {
+            if (!pending.empty()) {
+                if (--pending.back() == 0) pending.pop_back();
+                continue;
+            }
+            size_t index = std::stoi(instr.dest.substr(1));
+            if (index >= count || !args[index].empty()) return false;
+            args[index] = instr.src1;
+            positions.push_back(j);
+        } else if (same_block && (instr.op == TacOp::LABEL || is_terminator(instr.op))) {
+            return false;
+        }
+    }
+    return positions.size() == count;
+}
+
 // Build Control Flow Graph for a function
-void FunctionIR::build_cfg() {
+// A block starts at a label, at the first instruction, or right after a
+// branch/return; its instrs include the leading LABEL so that blocks can be
+// edited and flattened back into FunctionIR::instrs.
+inline void FunctionIR::build_cfg() {
     blocks.clear();
     block_index.clear();
 
     if (instrs.empty()) return;
 
-    // Find all label positions
-    std::unordered_map<std::string, int> label_pos;
-    for (int i = 0; i < (int)instrs.size(); i++) {
-        if (instrs[i].op == TacOp::LABEL) {
-            label_pos[instrs[i].src1] = i;
-        }
-    }
-
     // Create basic blocks
+    std::unordered_map<std::string, int> label_block;
     int i = 0;
     while (i < (int)instrs.size()) {
-        // Skip labels (they should be at the start of blocks)
+        std::string block_name = ".B" + std::to_string(blocks.size());
+        BasicBlock block(block_name, i);
+
         if (instrs[i].op == TacOp::LABEL) {
+            block.label = instrs[i].src2;
+            label_block[block.label] = blocks.size();
+            block.instrs.push_back(instrs[i]);
             i++;
-            continue;
         }
 
-        // Start a new block at current position
-        std::string block_name = ".B" + std::to_string(blocks.size());
-        BasicBlock block(block_name, i);
-
         // Collect instructions until we hit a terminator or next label
-        while (i < (int)instrs.size()) {
-            TacOp op = instrs[i].op;
-
-            // Block ends at control flow instructions
-            if (op == TacOp::JUMP || op == TacOp::BEQZ || op == TacOp::BNEZ ||
-                op == TacOp::RET || op == TacOp::CALL) {
-                // Include the terminator in this block
-                block.instrs.push_back(instrs[i]);
-                i++;
-                break;
-            }
-
-            // Block also ends at labels (which start new blocks)
-            if (op == TacOp::LABEL) {
-                break;
-            }
-
+        while (i < (int)instrs.size() && instrs[i].op != TacOp::LABEL) {
             block.instrs.push_back(instrs[i]);
             i++;
+            if (is_terminator(block.instrs.back().op)) break;
         }
 
         block.end_idx = i - 1;
-        int block_idx = blocks.size();
-        block_index[block_name] = block_idx;
+        block_index[block_name] = blocks.size();
         blocks.push_back(block);
     }
 
+    auto add_edge = [&](int from, int to) {
+        BasicBlock& src = blocks[from];
+        BasicBlock& dst = blocks[to];
+        if (std::find(src.successors.begin(), src.successors.end(), dst.name) != src.successors.end()) {
+            return;
+        }
+        src.successors.push_back(dst.name);
+        dst.predecessors.push_back(src.name);
+    };
+
     // Build predecessor/successor relationships
     for (int b = 0; b < (int)blocks.size(); b++) {
-        BasicBlock& block = blocks[b];
-
-        if (block.instrs.empty()) continue;
-
+        const BasicBlock& block = blocks[b];
         TacOp last_op = block.instrs.back().op;
 
-        // Unconditional jump: jump label
-        if (last_op == TacOp::JUMP) {
-            std::string target = block.instrs.back().src1;
-            if (label_pos.count(target)) {
-                std::string target_block = ".B" + std::to_string(block_index.size());
-                // Find which block contains this label
-                for (int j = 0; j < (int)blocks.size(); j++) {
-                    if (blocks[j].start_idx <= label_pos[target] &&
-                        (j == (int)blocks.size() - 1 || blocks[j+1].start_idx > label_pos[target])) {
-                        target_block = blocks[j].name;
-                        blocks[j].predecessors.push_back(block.name);
-                        break;
-                    }
-                }
-                block.successors.push_back(target_block);
-            }
+        if (last_op == TacOp::RET) {
+            // Return - no successors
+            continue;
         }
-        // Conditional branch: beqz/bnez cond, label
-        else if (last_op == TacOp::BEQZ || last_op == TacOp::BNEZ) {
-            std::string target = block.instrs.back().src2;
-            // Next block
-            if (b + 1 < (int)blocks.size()) {
-                block.successors.push_back(blocks[b + 1].name);
-                blocks[b + 1].predecessors.push_back(block.name);
+        if (last_op == TacOp::JUMP || last_op == TacOp::BEQZ || last_op == TacOp::BNEZ) {
+            // Conditional branches fall through first, then take the target
+            if (last_op != TacOp::JUMP && b + 1 < (int)blocks.size()) {
+                add_edge(b, b + 1);
             }
-            // Target block
-            if (label_pos.count(target)) {
-                for (int j = 0; j < (int)blocks.size(); j++) {
-                    if (blocks[j].start_idx <= label_pos[target] &&
-                        (j == (int)blocks.size() - 1 || blocks[j+1].start_idx > label_pos[target])) {
-                        block.successors.push_back(blocks[j].name);
-                        blocks[j].predecessors.push_back(block.name);
-                        break;
-                    }
-                }
+            auto it = label_block.find(branch_target(block.instrs.back()));
+            if (it != label_block.end()) {
+                add_edge(b, it->second);
             }
+            continue;
+        }
+        // Fall-through to next block
+        if (b + 1 < (int)blocks.size()) {
+            add_edge(b, b + 1);
         }
-        // Function call - may have multiple successors (call + next)
-        else if (last_op == TacOp::CALL) {
-            // Next block
-            if (b + 1 < (int)blocks.size()) {
-                block.successors.push_back(blocks[b + 1].name);
-                blocks[b + 1].predecessors.push_back(block.name);
+    }
+}
+
+inline void FunctionIR::flatten_blocks() {
+    instrs.clear();
+    for (const auto& block : blocks) {
+        instrs.insert(instrs.end(), block.instrs.begin(), block.instrs.end());
+    }
+    build_cfg();
+}
+
+inline void FunctionIR::label_all_blocks() {
+    bool changed = false;
+    for (auto& block : blocks) {
+        if (block.label.empty()) {
+            block.label = next_label();
+            block.instrs.insert(block.instrs.begin(), TacInstr(TacOp::LABEL, "", "", block.label));
+            changed = true;
+        }
+    }
+    if (changed) flatten_blocks();
+}
+
+inline std::vector<int> FunctionIR::reverse_post_order() const {
+    std::vector<int> order;
+    if (blocks.empty()) return order;
+
+    // Iterative DFS from the entry block
+    std::vector<char> visited(blocks.size(), 0);
+    std::vector<std::pair<int, size_t>> stack;
+    stack.push_back({0, 0});
+    visited[0] = 1;
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const BasicBlock& block = blocks[top.first];
+        if (top.second < block.successors.size()) {
+            int succ = block_index.at(block.successors[top.second++]);
+            if (!visited[succ]) {
+                visited[succ] = 1;
+                stack.push_back({succ, 0});
             }
+        } else {
+            order.push_back(top.first);
+            stack.pop_back();
         }
-        // Return - no successors
-        else if (last_op == TacOp::RET) {
-            // No successors
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+inline void FunctionIR::remove_unreachable_blocks() {
+    std::vector<int> rpo = reverse_post_order();
+    if (rpo.size() == blocks.size()) return;
+
+    std::vector<char> reachable(blocks.size(), 0);
+    for (int b : rpo) reachable[b] = 1;
+
+    std::unordered_set<std::string> dead_labels;
+    std::vector<BasicBlock> kept;
+    for (int b = 0; b < (int)blocks.size(); b++) {
+        if (reachable[b]) {
+            kept.push_back(blocks[b]);
+        } else if (!blocks[b].label.empty()) {
+            dead_labels.insert(blocks[b].label);
         }
-        // Fall-through to next block
-        else {
-            if (b + 1 < (int)blocks.size()) {
-                block.successors.push_back(blocks[b + 1].name);
-                blocks[b + 1].predecessors.push_back(block.name);
+    }
+    // PHIs must forget operands flowing in from removed blocks
+    for (auto& block : kept) {
+        for (auto& instr : block.instrs) {
+            if (instr.op != TacOp::PHI) continue;
+            std::vector<std::pair<std::string, std::string>> args;
+            for (const auto& arg : instr.phi_args) {
+                if (!dead_labels.count(arg.first)) args.push_back(arg);
             }
+            instr.phi_args = std::move(args);
         }
     }
+    blocks = std::move(kept);
+    flatten_blocks();
 }
 
 // Compute liveness for all variables in the function
-void FunctionIR::compute_liveness() {
+inline void FunctionIR::compute_liveness() {
     if (blocks.empty()) return;
 
     // Collect all variables (temps and user vars)
     all_vars.clear();
     for (const auto& instr : instrs) {
+        if (instr.op == TacOp::LABEL || instr.op == TacOp::JUMP) continue;
         // Exclude physical register names (a0-a7, t0-t6, s0-s11, etc.)
-        if (!instr.dest.empty() && !is_temp(instr.dest) && !is_physical_reg(instr.dest))
+        if (instr_has_def(instr) && is_variable(instr.dest))
             all_vars.insert(instr.dest);
-        if (!instr.src1.empty() && !is_number(instr.src1) && !is_temp(instr.src1) && !is_physical_reg(instr.src1))
-            all_vars.insert(instr.src1);
-        if (!instr.src2.empty() && !is_number(instr.src2) && !is_temp(instr.src2) && !is_physical_reg(instr.src2))
-            all_vars.insert(instr.src2);
-    }
-    // Add temps
-    for (const auto& instr : instrs) {
-        if (!instr.dest.empty() && is_temp(instr.dest)) all_vars.insert(instr.dest);
-        if (!instr.src1.empty() && is_temp(instr.src1)) all_vars.insert(instr.src1);
-        if (!instr.src2.empty() && is_temp(instr.src2)) all_vars.insert(instr.src2);
+        for (const std::string* slot : instr_use_slots(instr)) {
+            if (is_variable(*slot)) all_vars.insert(*slot);
+        }
     }
 
     // Compute def and use for each block
+    // PHI operands are charged to the predecessor they flow in from
+    std::unordered_map<std::string, std::set<std::string>> phi_uses;  // pred label -> vars
     for (auto& block : blocks) {
         block.def.clear();
         block.use.clear();
+        block.live_in.clear();
+        block.live_out.clear();
 
         for (const auto& instr : block.instrs) {
             std::unordered_set<std::string> use, def;
             instr_use_def(instr, use, def);
 
+            if (instr.op == TacOp::PHI) {
+                for (const auto& arg : instr.phi_args) {
+                    if (!is_number(arg.second)) phi_uses[arg.first].insert(arg.second);
+                }
+                use.clear();
+            }
+
             // For use: variable is used before being defined in this block
             for (const auto& v : use) {
                 if (!block.def.count(v)) {
@@ -300,39 +458,150 @@ void FunctionIR::compute_liveness() {
         }
     }
 
-    // Iterative liveness analysis (backward dataflow)
+    // Iterative liveness analysis (backward dataflow), visiting blocks in
+    // post-order so most facts settle in a single sweep
+    std::vector<int> order = reverse_post_order();
+    std::reverse(order.begin(), order.end());
     bool changed = true;
     while (changed) {
         changed = false;
 
-        for (auto& block : blocks) {
-            std::set<std::string> old_live_in = block.live_in;
-            std::set<std::string> old_live_out = block.live_out;
+        for (int b : order) {
+            BasicBlock& block = blocks[b];
 
-            // live_out[B] = union of live_in of all successors
-            block.live_out.clear();
+            // live_out[B] = union of live_in of all successors, plus the PHI
+            // operands the successors read along the edge from B
+            std::set<std::string> live_out;
             for (const auto& succ_name : block.successors) {
-                if (block_index.count(succ_name)) {
-                    int succ_idx = block_index[succ_name];
-                    block.live_out.insert(blocks[succ_idx].live_in.begin(),
-                                         blocks[succ_idx].live_in.end());
-                }
+                const BasicBlock& succ = blocks[block_index[succ_name]];
+                live_out.insert(succ.live_in.begin(), succ.live_in.end());
+            }
+            if (!block.label.empty()) {
+                auto it = phi_uses.find(block.label);
+                if (it != phi_uses.end()) live_out.insert(it->second.begin(), it->second.end());
             }
 
             // live_in[B] = use[B] union (live_out[B] - def[B])
-            block.live_in = block.use;
-            for (const auto& v : block.live_out) {
+            std::set<std::string> live_in = block.use;
+            for (const auto& v : live_out) {
                 if (!block.def.count(v)) {
-                    block.live_in.insert(v);
+                    live_in.insert(v);
                 }
             }
 
             // Check if anything changed
-            if (block.live_in != old_live_in || block.live_out != old_live_out) {
+            if (live_in != block.live_in || live_out != block.live_out) {
+                block.live_in = std::move(live_in);
+                block.live_out = std::move(live_out);
                 changed = true;
             }
         }
     }
 }
 
+// Compute immediate dominators (Cooper-Harvey-Kennedy) and dominance frontiers
+inline void FunctionIR::compute_dominators() {
+    for (auto& block : blocks) {
+        block.idom.clear();
+        block.dom_children.clear();
+        block.dom_frontier.clear();
+    }
+    if (blocks.empty()) return;
+
+    std::vector<int> rpo = reverse_post_order();
+    std::vector<int> rpo_num(blocks.size(), -1);
+    for (int i = 0; i < (int)rpo.size(); i++) rpo_num[rpo[i]] = i;
+
+    std::vector<int> idom(blocks.size(), -1);
+    idom[0] = 0;
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rpo_num[a] > rpo_num[b]) a = idom[a];
+            while (rpo_num[b] > rpo_num[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < (int)rpo.size(); i++) {
+            int b = rpo[i];
+            int new_idom = -1;
+            for (const auto& pred_name : blocks[b].predecessors) {
+                int p = block_index[pred_name];
+                if (idom[p] == -1) continue;
+                new_idom = new_idom == -1 ? p : intersect(p, new_idom);
+            }
+            if (new_idom != -1 && idom[b] != new_idom) {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    for (int b : rpo) {
+        if (b == 0) continue;
+        blocks[b].idom = blocks[idom[b]].name;
+        blocks[idom[b]].dom_children.push_back(blocks[b].name);
+    }
+
+    // Dominance frontiers: walk up from each predecessor of a join point
+    for (int b : rpo) {
+        if (blocks[b].predecessors.size() < 2) continue;
+        for (const auto& pred_name : blocks[b].predecessors) {
+            int runner = block_index[pred_name];
+            if (rpo_num[runner] == -1) continue;
+            while (runner != idom[b]) {
+                blocks[runner].dom_frontier.insert(blocks[b].name);
+                runner = idom[runner];
+            }
+        }
+    }
+}
+
+inline bool FunctionIR::dominates(int a, int b) const {
+    while (true) {
+        if (a == b) return true;
+        const std::string& idom = blocks[b].idom;
+        if (idom.empty()) return false;
+        b = block_index.at(idom);
+    }
+}
+
+// An edge n -> h where h dominates n is a back edge; its natural loop is h
+// plus everything that reaches n without passing through h. Back edges
+// sharing a header form a single loop.
+inline std::unordered_map<int, std::set<int>> FunctionIR::natural_loops() const {
+    std::unordered_map<int, std::set<int>> loops;  // header -> body
+    for (int n = 0; n < (int)blocks.size(); n++) {
+        for (const auto& succ_name : blocks[n].successors) {
+            int h = block_index.at(succ_name);
+            if (!dominates(h, n)) continue;
+
+            std::set<int>& body = loops[h];
+            body.insert(h);
+            std::vector<int> worklist;
+            if (body.insert(n).second) worklist.push_back(n);
+            while (!worklist.empty()) {
+                int b = worklist.back();
+                worklist.pop_back();
+                for (const auto& pred_name : blocks[b].predecessors) {
+                    int p = block_index.at(pred_name);
+                    if (body.insert(p).second) worklist.push_back(p);
+                }
+            }
+        }
+    }
+    return loops;
+}
+
+inline void FunctionIR::compute_loop_depths() {
+    for (auto& block : blocks) block.loop_depth = 0;
+    for (const auto& loop : natural_loops()) {
+        for (int b : loop.second) blocks[b].loop_depth++;
+    }
+}
+
 #endif // CFG_H
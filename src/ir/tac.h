@@ -37,6 +37,9 @@ struct TacInstr {
     std::string src2;      // Second source (can be empty for unary ops)
     std::string comment;   // For debugging
 
+    // PHI operands: (predecessor block label, incoming value)
+    std::vector<std::pair<std::string, std::string>> phi_args;
+
     TacInstr(TacOp operation, const std::string& d = "",
              const std::string& s1 = "", const std::string& s2 = "")
         : op(operation), dest(d), src1(s1), src2(s2) {}
@@ -55,6 +58,9 @@ struct TacInstr {
         if (!dest.empty()) s += " " + dest;
         if (!src1.empty()) s += ", " + src1;
         if (!src2.empty()) s += ", " + src2;
+        for (const auto& arg : phi_args) {
+            s += ", [" + arg.first + ": " + arg.second + "]";
+        }
         return s;
     }
 };
@@ -62,11 +68,12 @@ struct TacInstr {
 // Basic Block structure for Control Flow Graph
 struct BasicBlock {
     std::string name;
+    std::string label;       // Label that starts this block (empty if none)
     int start_idx;           // Start instruction index
     int end_idx;             // End instruction index (inclusive)
     std::vector<std::string> predecessors;   // Names of predecessor blocks
     std::vector<std::string> successors;     // Names of successor blocks
-    std::vector<TacInstr> instrs;            // Instructions in this block
+    std::vector<TacInstr> instrs;            // Instructions in this block (leading LABEL included)
 
     // Liveness analysis results
     std::set<std::string> live_in;           // Variables live at block entry
@@ -74,6 +81,14 @@ struct BasicBlock {
     std::set<std::string> def;               // Variables defined (written) in block
     std::set<std::string> use;               // Variables used (read) before definition
 
+    // Dominance analysis results
+    std::string idom;                        // Immediate dominator (empty for entry)
+    std::vector<std::string> dom_children;   // Blocks immediately dominated by this one
+    std::set<std::string> dom_frontier;      // Dominance frontier
+
+    // Loop analysis results
+    int loop_depth = 0;                      // Number of natural loops containing the block
+
     BasicBlock(const std::string& n = "", int start = 0)
         : name(n), start_idx(start), end_idx(-1) {}
 };
@@ -107,6 +122,29 @@ public:
     // CFG building methods
     void build_cfg();
     void compute_liveness();
+    void compute_dominators();
+    // Natural loops from back edges, header -> body (header included);
+    // loops sharing a header are merged. Needs compute_dominators
+    std::unordered_map<int, std::set<int>> natural_loops() const;
+    // Loop nesting depth of every block; needs compute_dominators
+    void compute_loop_depths();
+
+    // Rebuild the flat instruction list from the (possibly edited) blocks
+    void flatten_blocks();
+    // Give every block a leading label so PHIs can name their predecessors
+    void label_all_blocks();
+    // Drop blocks not reachable from the entry block
+    void remove_unreachable_blocks();
+
+    // Block helpers
+    BasicBlock* get_block(const std::string& block_name) {
+        auto it = block_index.find(block_name);
+        return it != block_index.end() ? &blocks[it->second] : nullptr;
+    }
+    // Reverse post-order of blocks reachable from the entry
+    std::vector<int> reverse_post_order() const;
+    // Whether block a dominates block b (both indices); needs compute_dominators
+    bool dominates(int a, int b) const;
 
 private:
     int temp_count_ = 0;
@@ -3,6 +3,7 @@
 #include <string>
 #include <memory>
 #include <cstring>
+#include <cstdlib>
 #include <stdexcept>
 
 // Include generated parser header
@@ -23,11 +24,16 @@ extern int yyparse();
 
 // Command line options
 bool opt_enabled = false;
+bool graph_coloring = false;  // -regalloc=graph
+int mul_cost = 1;             // -mul-cost=N
 std::string input_file;
 
 void print_usage(const char* prog) {
-    std::cerr << "Usage: " << prog << " [-opt] [input_file]\n";
+    std::cerr << "Usage: " << prog << " [-opt] [-regalloc=linear|graph] [input_file]\n";
     std::cerr << "  -opt    Enable optimizations\n";
+    std::cerr << "  -regalloc=graph  Use the graph-coloring register allocator (default: linear)\n";
+    std::cerr << "  -mul-cost=N  Cycles of a mul on the target core; multiplies by a constant\n"
+                 "               become shift/add chains of at most N instructions (default: 1)\n";
     std::cerr << "  input   Input file (default: stdin)\n";
 }
 
@@ -36,6 +42,12 @@ int main(int argc, char* argv[]) {
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-opt") == 0) {
             opt_enabled = true;
+        } else if (strcmp(argv[i], "-regalloc=graph") == 0) {
+            graph_coloring = true;
+        } else if (strcmp(argv[i], "-regalloc=linear") == 0) {
+            graph_coloring = false;
+        } else if (strncmp(argv[i], "-mul-cost=", 10) == 0) {
+            mul_cost = atoi(argv[i] + 10);
         } else if (argv[i][0] != '-') {
             input_file = argv[i];
         }
@@ -82,7 +94,7 @@ int main(int argc, char* argv[]) {
         }
 
         // Code generation
-        RISC32Generator generator(ir);
+        RISC32Generator generator(ir, graph_coloring, mul_cost);
         std::string asm_code = generator.generate();
 
         // Output
@@ -0,0 +1,190 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Global value numbering over the dominator tree (Briggs, Cooper & Simpson's
+// dominator-based value numbering) on SSA form.
+//
+// Each pure instruction is hashed as (op, value numbers of its operands); if
+// a dominating block already computed the same key, the instruction is
+// deleted and its name becomes another name for the earlier result. The
+// table is scoped to the dominator tree, so a value is only reused where its
+// definition dominates the reuse. Copies simply share their source's number,
+// and a PHI whose operands all carry one value number is that value.
+//
+// Commutative operators sort their operands, and GT/GE are keyed as the
+// swapped LT/LE, so a + b and b + a (or a > b and b < a) meet in the table.
+
+namespace {
+
+struct ValueNumbering {
+    FunctionIR* func;
+    std::unordered_set<std::string> single_def;           // SSA names (one definition)
+    std::unordered_map<std::string, std::string> leader;  // name -> value number (a name)
+    std::unordered_map<std::string, std::string> table;   // expression key -> name
+
+    explicit ValueNumbering(FunctionIR* f) : func(f) {}
+
+    std::string vn(const std::string& name) const {
+        auto it = leader.find(name);
+        return it == leader.end() ? name : it->second;
+    }
+
+    // An operand whose value can change between two evaluations
+    bool unstable(const std::string& s) const {
+        return is_variable(s) && !single_def.count(s);
+    }
+
+    static bool is_commutative(TacOp op) {
+        return op == TacOp::ADD || op == TacOp::MUL || op == TacOp::EQ || op == TacOp::NE ||
+               op == TacOp::AND || op == TacOp::OR;
+    }
+
+    // Hash key of a pure instruction, or "" if it must not be numbered
+    std::string key_of(const TacInstr& instr) const {
+        switch (instr.op) {
+            case TacOp::LOAD_IMM:
+                return "imm " + instr.src1;
+            case TacOp::NOT:
+                if (unstable(instr.src1)) return "";
+                return "not " + vn(instr.src1);
+            case TacOp::ADD: case TacOp::SUB: case TacOp::MUL: case TacOp::DIV: case TacOp::MOD:
+            case TacOp::AND: case TacOp::OR:
+            case TacOp::LT: case TacOp::GT: case TacOp::LE: case TacOp::GE:
+            case TacOp::EQ: case TacOp::NE: {
+                if (unstable(instr.src1) || unstable(instr.src2)) return "";
+                TacOp op = instr.op;
+                std::string a = vn(instr.src1);
+                std::string b = vn(instr.src2);
+                if (op == TacOp::GT || op == TacOp::GE) {
+                    op = op == TacOp::GT ? TacOp::LT : TacOp::LE;
+                    std::swap(a, b);
+                }
+                if (is_commutative(op) && b < a) std::swap(a, b);
+                return std::to_string(static_cast<int>(op)) + " " + a + " " + b;
+            }
+            default:
+                return "";
+        }
+    }
+
+    // Source of a copy between SSA values, or "" if the instruction is not one
+    std::string copy_source(const TacInstr& instr) const {
+        if (instr.op != TacOp::MOVE && instr.op != TacOp::STORE && instr.op != TacOp::LOAD) return "";
+        if (!is_variable(instr.src1) || unstable(instr.src1)) return "";
+        return instr.src1;
+    }
+
+    void visit(int b) {
+        BasicBlock& block = func->blocks[b];
+        std::vector<std::string> scope_keys;
+        std::vector<TacInstr> kept;
+
+        for (auto& instr : block.instrs) {
+            bool defines = instr_has_def(instr) && is_variable(instr.dest) && single_def.count(instr.dest);
+
+            if (instr.op == TacOp::PHI) {
+                if (defines) {
+                    // Trivial PHI: every operand other than itself is one value
+                    std::string same;
+                    bool trivial = true;
+                    for (const auto& arg : instr.phi_args) {
+                        std::string v = vn(arg.second);
+                        if (v == instr.dest || unstable(arg.second)) {
+                            trivial = trivial && v == instr.dest;
+                            continue;
+                        }
+                        if (same.empty()) same = v;
+                        else if (same != v) trivial = false;
+                    }
+                    if (trivial && !same.empty()) {
+                        leader[instr.dest] = same;
+                        continue;
+                    }
+                    // Identical PHIs in the same block
+                    std::string key = "phi " + std::to_string(b);
+                    for (const auto& arg : instr.phi_args) key += " " + arg.first + "=" + vn(arg.second);
+                    auto it = table.find(key);
+                    if (it != table.end()) {
+                        leader[instr.dest] = it->second;
+                        continue;
+                    }
+                    table[key] = instr.dest;
+                    scope_keys.push_back(key);
+                }
+                kept.push_back(instr);
+                continue;
+            }
+
+            // Operands take the value number of the name they refer to
+            for (std::string* slot : instr_use_slots(instr)) {
+                if (is_variable(*slot) && !unstable(*slot)) *slot = vn(*slot);
+            }
+
+            if (defines) {
+                std::string src = copy_source(instr);
+                if (!src.empty()) {
+                    leader[instr.dest] = vn(src);
+                    continue;
+                }
+                std::string key = key_of(instr);
+                if (!key.empty()) {
+                    auto it = table.find(key);
+                    if (it != table.end()) {
+                        leader[instr.dest] = it->second;
+                        continue;
+                    }
+                    table[key] = instr.dest;
+                    scope_keys.push_back(key);
+                }
+            }
+            kept.push_back(instr);
+        }
+        block.instrs = std::move(kept);
+
+        for (const auto& child : block.dom_children) {
+            visit(func->block_index[child]);
+        }
+        for (const auto& key : scope_keys) {
+            table.erase(key);
+        }
+    }
+
+    void run() {
+        std::unordered_map<std::string, int> def_count;
+        for (const auto& instr : func->instrs) {
+            if (instr_has_def(instr) && is_variable(instr.dest)) def_count[instr.dest]++;
+        }
+        for (const auto& entry : def_count) {
+            if (entry.second == 1) single_def.insert(entry.first);
+        }
+
+        func->compute_dominators();
+        visit(0);
+
+        // Uses the walk has not reached yet (PHI operands along back edges)
+        for (auto& block : func->blocks) {
+            for (auto& instr : block.instrs) {
+                for (std::string* slot : instr_use_slots(instr)) {
+                    if (is_variable(*slot) && !unstable(*slot)) *slot = vn(*slot);
+                }
+            }
+        }
+        func->flatten_blocks();
+    }
+};
+
+} // namespace
+
+void Optimizer::gvn(ProgramIR* program) {
+    for (auto& func : program->functions) {
+        func->build_cfg();
+        if (func->blocks.empty()) continue;
+        func->remove_unreachable_blocks();
+        ValueNumbering numbering(func.get());
+        numbering.run();
+    }
+}
@@ -0,0 +1,328 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Function inlining on SSA form.
+//
+// Callers are visited bottom-up over the call graph, so a callee has already
+// absorbed its own small callees when it is considered. Recursive functions
+// (anything on a call-graph cycle) are never inlined.
+//
+// A call site is inlined when the callee's TAC size stays under a threshold
+// that grows with the loop depth of the call site (the call overhead is paid
+// on every iteration) and with the number of constant arguments (SCCP can
+// fold them into the body afterwards), as long as the caller stays under a
+// size budget.
+//
+// The callee body is cloned between the instructions before and after the
+// CALL with every SSA name and label renamed to fresh caller names:
+//     LOAD_PARAM d, aN / LOAD d, "#s0:off"   become copies of the argument
+//     MOVE a0, v; RET                         becomes JUMP to the continuation
+// and the continuation merges the returned values in a PHI that defines the
+// call's result. Functions that are no longer reachable from main are
+// dropped afterwards.
+
+namespace {
+
+const int kBaseThreshold = 12;      // Callee size (TAC instructions) always worth inlining
+const int kLoopDepthBonus = 24;     // Extra size allowed per loop level around the call
+const int kMaxLoopDepth = 3;
+const int kConstantArgBonus = 4;    // Extra size allowed per constant argument
+const int kMaxCallerSize = 2000;    // Caller growth limit
+
+int function_size(const FunctionIR& func) {
+    int size = 0;
+    for (const auto& instr : func.instrs) {
+        if (instr.op != TacOp::LABEL && instr.op != TacOp::PHI) size++;
+    }
+    return size;
+}
+
+struct Inliner {
+    ProgramIR* program;
+    std::unordered_map<std::string, std::set<std::string>> callees;
+    std::unordered_set<std::string> recursive;
+
+    explicit Inliner(ProgramIR* p) : program(p) {}
+
+    void build_call_graph() {
+        callees.clear();
+        for (auto& func : program->functions) {
+            auto& edges = callees[func->name];
+            for (const auto& instr : func->instrs) {
+                if (instr.op == TacOp::CALL && program->get_function(instr.src1)) edges.insert(instr.src1);
+            }
+        }
+        recursive.clear();
+        for (auto& func : program->functions) {
+            std::unordered_set<std::string> seen;
+            std::vector<std::string> worklist(callees[func->name].begin(), callees[func->name].end());
+            while (!worklist.empty()) {
+                std::string name = worklist.back();
+                worklist.pop_back();
+                if (name == func->name) {
+                    recursive.insert(name);
+                    break;
+                }
+                if (!seen.insert(name).second) continue;
+                for (const auto& next : callees[name]) worklist.push_back(next);
+            }
+        }
+    }
+
+    // Functions ordered callees first
+    std::vector<FunctionIR*> bottom_up() {
+        std::vector<FunctionIR*> order;
+        std::unordered_set<std::string> visited;
+        std::function<void(const std::string&)> visit = [&](const std::string& name) {
+            if (!visited.insert(name).second) return;
+            for (const auto& callee : callees[name]) visit(callee);
+            order.push_back(program->get_function(name));
+        };
+        for (auto& func : program->functions) visit(func->name);
+        return order;
+    }
+
+    // Only plain returns may write a0, and parameters come from a0-a7 or the stack
+    bool can_clone(const FunctionIR& callee) const {
+        bool has_return = false;
+        for (size_t i = 0; i < callee.instrs.size(); i++) {
+            const TacInstr& instr = callee.instrs[i];
+            if (instr.op == TacOp::RET) has_return = true;
+            if (instr.op == TacOp::MOVE && !is_variable(instr.dest)) {
+                if (i + 1 >= callee.instrs.size() || callee.instrs[i + 1].op != TacOp::RET) return false;
+            }
+            if (instr.op == TacOp::LOAD && !is_variable(instr.src1) && param_load_index(instr) < 0) return false;
+            if (instr.op == TacOp::STORE && !is_variable(instr.dest)) return false;
+        }
+        bool falls_off = callee.instrs.empty() || (callee.instrs.back().op != TacOp::RET &&
+                                                   callee.instrs.back().op != TacOp::JUMP);
+        return has_return || falls_off;
+    }
+
+    bool worth_inlining(FunctionIR* caller, FunctionIR* callee, int loop_depth,
+                        const std::vector<std::string>& args,
+                        const std::unordered_set<std::string>& constants) const {
+        int threshold = kBaseThreshold + std::min(loop_depth, kMaxLoopDepth) * kLoopDepthBonus;
+        for (const auto& arg : args) {
+            if (is_number(arg) || constants.count(arg)) threshold += kConstantArgBonus;
+        }
+        int size = function_size(*callee);
+        return size <= threshold && function_size(*caller) + size <= kMaxCallerSize;
+    }
+
+    // Clone callee in place of the CALL at blocks[b].instrs[call]
+    void inline_call(FunctionIR* caller, int b, int call, FunctionIR* callee,
+                     const std::vector<std::string>& args, const std::vector<int>& positions) {
+        std::unordered_map<std::string, std::string> names, labels;
+        auto rename = [&](const std::string& s) {
+            if (!is_variable(s)) return s;
+            auto it = names.find(s);
+            if (it == names.end()) it = names.emplace(s, caller->next_temp()).first;
+            return it->second;
+        };
+        auto relabel = [&](const std::string& l) {
+            auto it = labels.find(l);
+            if (it == labels.end()) it = labels.emplace(l, caller->next_label()).first;
+            return it->second;
+        };
+        auto copy_of = [&](const std::string& dest, const std::string& value) {
+            if (is_number(value)) return TacInstr(TacOp::LOAD_IMM, dest, value);
+            return TacInstr(TacOp::MOVE, dest, value);
+        };
+
+        const TacInstr call_instr = caller->blocks[b].instrs[call];
+        const std::string& result = call_instr.dest;
+        std::string cont = caller->next_label();
+
+        callee->build_cfg();
+        callee->label_all_blocks();
+
+        std::vector<TacInstr> body;
+        std::vector<std::pair<std::string, std::string>> returns;  // block label -> value
+        for (size_t bi = 0; bi < callee->blocks.size(); bi++) {
+            const BasicBlock& block = callee->blocks[bi];
+            std::string label = relabel(block.label);
+            bool terminated = false;
+            for (const auto& original : block.instrs) {
+                TacInstr instr = original;
+                switch (instr.op) {
+                    case TacOp::LABEL:
+                        instr.src2 = relabel(instr.src2);
+                        break;
+                    case TacOp::JUMP:
+                        instr.src2 = relabel(instr.src2);
+                        terminated = true;
+                        break;
+                    case TacOp::BEQZ: case TacOp::BNEZ:
+                        instr.src1 = rename(instr.src1);
+                        instr.src2 = relabel(instr.src2);
+                        break;
+                    case TacOp::PHI:
+                        instr.dest = rename(instr.dest);
+                        for (auto& arg : instr.phi_args) {
+                            arg.first = relabel(arg.first);
+                            arg.second = rename(arg.second);
+                        }
+                        break;
+                    case TacOp::LOAD_PARAM:
+                        instr = copy_of(rename(instr.dest), args[param_load_index(instr)]);
+                        break;
+                    case TacOp::LOAD:
+                        if (!is_variable(instr.src1)) {
+                            instr = copy_of(rename(instr.dest), args[param_load_index(instr)]);
+                            break;
+                        }
+                        instr.dest = rename(instr.dest);
+                        instr.src1 = rename(instr.src1);
+                        break;
+                    case TacOp::CALL:
+                        instr.dest = rename(instr.dest);
+                        break;
+                    case TacOp::RET: {
+                        std::string value;
+                        if (!body.empty() && body.back().op == TacOp::MOVE && body.back().dest == "a0") {
+                            value = body.back().src1;
+                            body.pop_back();
+                        }
+                        if (value.empty() && !result.empty()) {
+                            value = caller->next_temp();
+                            body.push_back(TacInstr(TacOp::LOAD_IMM, value, "0"));
+                        }
+                        returns.push_back({label, value});
+                        instr = TacInstr(TacOp::JUMP, "", "", cont);
+                        terminated = true;
+                        break;
+                    }
+                    default:
+                        if (is_variable(instr.dest)) instr.dest = rename(instr.dest);
+                        for (std::string* slot : instr_use_slots(instr)) *slot = rename(*slot);
+                        break;
+                }
+                body.push_back(instr);
+            }
+            // Falling off the end of the callee returns as well
+            if (bi + 1 == callee->blocks.size() && !terminated) {
+                if (!body.empty() && is_terminator(body.back().op)) {
+                    label = caller->next_label();
+                    body.push_back(TacInstr(TacOp::LABEL, "", "", label));
+                }
+                std::string value;
+                if (!result.empty()) {
+                    value = caller->next_temp();
+                    body.push_back(TacInstr(TacOp::LOAD_IMM, value, "0"));
+                }
+                returns.push_back({label, value});
+            }
+        }
+
+        std::vector<TacInstr> join;
+        join.push_back(TacInstr(TacOp::LABEL, "", "", cont));
+        if (!result.empty()) {
+            if (returns.size() == 1) {
+                join.push_back(copy_of(result, returns[0].second));
+            } else {
+                TacInstr phi(TacOp::PHI, result);
+                phi.phi_args = returns;
+                join.push_back(phi);
+            }
+        }
+
+        // Successors of the call's block are now entered from the continuation
+        BasicBlock& site = caller->blocks[b];
+        for (auto& block : caller->blocks) {
+            for (auto& instr : block.instrs) {
+                if (instr.op != TacOp::PHI) continue;
+                for (auto& arg : instr.phi_args) {
+                    if (arg.first == site.label) arg.first = cont;
+                }
+            }
+        }
+
+        std::vector<TacInstr> spliced;
+        for (int i = 0; i < call; i++) {
+            if (std::find(positions.begin(), positions.end(), i) == positions.end()) {
+                spliced.push_back(site.instrs[i]);
+            }
+        }
+        spliced.insert(spliced.end(), body.begin(), body.end());
+        spliced.insert(spliced.end(), join.begin(), join.end());
+        spliced.insert(spliced.end(), site.instrs.begin() + call + 1, site.instrs.end());
+        site.instrs = std::move(spliced);
+        caller->flatten_blocks();
+    }
+
+    // Inline one call site of caller; false when none qualifies
+    bool inline_one(FunctionIR* caller) {
+        caller->build_cfg();
+        if (caller->blocks.empty()) return false;
+        caller->label_all_blocks();
+        caller->compute_dominators();
+        caller->compute_loop_depths();
+
+        std::unordered_set<std::string> constants;
+        for (const auto& instr : caller->instrs) {
+            if (instr.op == TacOp::LOAD_IMM) constants.insert(instr.dest);
+        }
+
+        // Last call first: an outer call follows the calls nested in its
+        // arguments, and its PARAMs are only contiguous until those are inlined
+        for (int b = (int)caller->blocks.size() - 1; b >= 0; b--) {
+            const auto& instrs = caller->blocks[b].instrs;
+            for (int i = (int)instrs.size() - 1; i >= 0; i--) {
+                if (instrs[i].op != TacOp::CALL) continue;
+                FunctionIR* callee = program->get_function(instrs[i].src1);
+                if (!callee || callee == caller || callee->name == "main" || recursive.count(callee->name)) {
+                    continue;
+                }
+                if (!can_clone(*callee)) continue;
+
+                std::vector<std::string> args;
+                std::vector<int> positions;
+                if (!call_arguments(program, instrs, i, callee->params.size(), args, positions)) continue;
+                if (!worth_inlining(caller, callee, caller->blocks[b].loop_depth, args, constants)) continue;
+
+                inline_call(caller, b, i, callee, args, positions);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void remove_unused_functions() {
+        if (!program->get_function("main")) return;
+        build_call_graph();
+        std::unordered_set<std::string> live;
+        std::vector<std::string> worklist = {"main"};
+        while (!worklist.empty()) {
+            std::string name = worklist.back();
+            worklist.pop_back();
+            if (!live.insert(name).second) continue;
+            for (const auto& callee : callees[name]) worklist.push_back(callee);
+        }
+        auto& functions = program->functions;
+        functions.erase(std::remove_if(functions.begin(), functions.end(),
+                                       [&](const std::unique_ptr<FunctionIR>& f) { return !live.count(f->name); }),
+                        functions.end());
+    }
+
+    void run() {
+        build_call_graph();
+        for (FunctionIR* caller : bottom_up()) {
+            while (inline_one(caller)) {}
+        }
+        remove_unused_functions();
+    }
+};
+
+} // namespace
+
+void Optimizer::inline_functions(ProgramIR* program) {
+    Inliner inliner(program);
+    inliner.run();
+}
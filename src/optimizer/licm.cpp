@@ -0,0 +1,202 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Loop-invariant code motion on SSA form.
+//
+// Loops are the natural loops of FunctionIR::natural_loops, visited innermost
+// first. An instruction is invariant when it has no side effects and every
+// operand is a constant or an SSA name defined outside the loop (or by
+// another invariant instruction). Invariant instructions move, in their
+// original order, to the end of the loop's preheader.
+//
+// If the header has a single outside predecessor that only flows into the
+// header, that block is the preheader. Otherwise a new block is placed right
+// before the header, the outside edges are redirected to it and the header
+// PHIs' outside operands are merged there.
+//
+// Hoisting executes the instruction even if the loop body never would. That
+// is harmless for everything except DIV/MOD, whose zero divisor is undefined
+// in ToyC: they only move when the divisor is a non-zero constant or they sit
+// in the header, which runs whenever the preheader does.
+
+namespace {
+
+bool is_pure(TacOp op) {
+    switch (op) {
+        case TacOp::ADD: case TacOp::SUB: case TacOp::MUL: case TacOp::DIV: case TacOp::MOD:
+        case TacOp::AND: case TacOp::OR: case TacOp::NOT:
+        case TacOp::LT: case TacOp::GT: case TacOp::LE: case TacOp::GE:
+        case TacOp::EQ: case TacOp::NE:
+        case TacOp::LOAD_IMM: case TacOp::MOVE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct LoopInvariantMotion {
+    FunctionIR* func;
+    std::unordered_map<std::string, int> def_count;
+    std::unordered_map<std::string, int> def_block;
+    std::unordered_map<std::string, std::string> constants;  // LOAD_IMM dest -> literal
+
+    explicit LoopInvariantMotion(FunctionIR* f) : func(f) {}
+
+    void collect_defs() {
+        def_count.clear();
+        def_block.clear();
+        constants.clear();
+        for (int b = 0; b < (int)func->blocks.size(); b++) {
+            for (const auto& instr : func->blocks[b].instrs) {
+                if (!instr_has_def(instr) || !is_variable(instr.dest)) continue;
+                def_count[instr.dest]++;
+                def_block[instr.dest] = b;
+                if (instr.op == TacOp::LOAD_IMM) constants[instr.dest] = instr.src1;
+            }
+        }
+    }
+
+    bool nonzero_constant(const std::string& s) const {
+        if (is_number(s)) return std::stoll(s) != 0;
+        auto it = constants.find(s);
+        return it != constants.end() && is_number(it->second) && std::stoll(it->second) != 0;
+    }
+
+    bool is_invariant(const TacInstr& instr, int b, int header, const std::set<int>& body,
+                      const std::unordered_set<std::string>& invariant) const {
+        if (!is_pure(instr.op) || !is_variable(instr.dest)) return false;
+        auto count = def_count.find(instr.dest);
+        if (count == def_count.end() || count->second != 1) return false;
+
+        if ((instr.op == TacOp::DIV || instr.op == TacOp::MOD) && b != header &&
+            !nonzero_constant(instr.src2)) {
+            return false;
+        }
+        for (const std::string* slot : instr_use_slots(instr)) {
+            const std::string& s = *slot;
+            if (is_number(s)) continue;
+            if (!is_variable(s)) return false;
+            auto c = def_count.find(s);
+            if (c == def_count.end() || c->second != 1) return false;
+            if (body.count(def_block.at(s)) && !invariant.count(s)) return false;
+        }
+        return true;
+    }
+
+    // Move the invariant instructions of one loop; false if there are none
+    bool hoist(int header, const std::set<int>& body) {
+        // Reverse post-order visits definitions before their (non-PHI) uses
+        std::unordered_set<std::string> invariant;
+        std::vector<TacInstr> hoisted;
+        for (int b : func->reverse_post_order()) {
+            if (!body.count(b)) continue;
+            auto& instrs = func->blocks[b].instrs;
+            std::vector<TacInstr> kept;
+            for (const auto& instr : instrs) {
+                if (is_invariant(instr, b, header, body, invariant)) {
+                    invariant.insert(instr.dest);
+                    hoisted.push_back(instr);
+                } else {
+                    kept.push_back(instr);
+                }
+            }
+            instrs = std::move(kept);
+        }
+        if (hoisted.empty()) return false;
+
+        BasicBlock& head = func->blocks[header];
+        std::vector<int> outside;
+        for (const auto& pred_name : head.predecessors) {
+            int p = func->block_index[pred_name];
+            if (!body.count(p)) outside.push_back(p);
+        }
+
+        // An existing block that can serve as the preheader
+        if (outside.size() == 1 && func->blocks[outside[0]].successors.size() == 1) {
+            auto& instrs = func->blocks[outside[0]].instrs;
+            auto pos = instrs.end();
+            if (!instrs.empty() && is_terminator(instrs.back().op)) --pos;
+            instrs.insert(pos, hoisted.begin(), hoisted.end());
+            func->flatten_blocks();
+            return true;
+        }
+
+        BasicBlock pre;
+        pre.label = func->next_label();
+        pre.instrs.push_back(TacInstr(TacOp::LABEL, "", "", pre.label));
+
+        std::unordered_set<std::string> outside_labels;
+        for (int p : outside) outside_labels.insert(func->blocks[p].label);
+        for (auto& instr : head.instrs) {
+            if (instr.op != TacOp::PHI) continue;
+            std::vector<std::pair<std::string, std::string>> inside_args, outside_args;
+            for (const auto& arg : instr.phi_args) {
+                (outside_labels.count(arg.first) ? outside_args : inside_args).push_back(arg);
+            }
+            if (outside_args.size() == 1) {
+                inside_args.push_back({pre.label, outside_args[0].second});
+            } else {
+                TacInstr merge(TacOp::PHI, func->next_temp(), "", "");
+                merge.phi_args = outside_args;
+                pre.instrs.push_back(merge);
+                inside_args.push_back({pre.label, merge.dest});
+            }
+            instr.phi_args = std::move(inside_args);
+        }
+        pre.instrs.insert(pre.instrs.end(), hoisted.begin(), hoisted.end());
+
+        // Outside edges now enter the preheader, which falls into the header
+        for (int p : outside) {
+            TacInstr& last = func->blocks[p].instrs.back();
+            if (is_terminator(last.op) && last.op != TacOp::RET && branch_target(last) == head.label) {
+                last.src2 = pre.label;
+            }
+        }
+        if (header > 0 && body.count(header - 1)) {
+            auto& instrs = func->blocks[header - 1].instrs;
+            if (instrs.empty() || (instrs.back().op != TacOp::JUMP && instrs.back().op != TacOp::RET)) {
+                instrs.push_back(TacInstr(TacOp::JUMP, "", "", head.label));
+            }
+        }
+        func->blocks.insert(func->blocks.begin() + header, pre);
+        func->flatten_blocks();
+        return true;
+    }
+
+    // Hoist out of one loop; false once no loop has anything left to move
+    bool run_once() {
+        func->build_cfg();
+        func->label_all_blocks();
+        func->compute_dominators();
+        collect_defs();
+
+        std::vector<std::pair<int, std::set<int>>> loops;
+        for (auto& loop : func->natural_loops()) {
+            if (loop.first != 0) loops.push_back(loop);
+        }
+        std::sort(loops.begin(), loops.end(), [](const auto& a, const auto& b) {
+            if (a.second.size() != b.second.size()) return a.second.size() < b.second.size();
+            return a.first < b.first;
+        });
+        for (const auto& loop : loops) {
+            if (hoist(loop.first, loop.second)) return true;
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+void Optimizer::licm(ProgramIR* program) {
+    for (auto& func : program->functions) {
+        func->build_cfg();
+        if (func->blocks.empty()) continue;
+        LoopInvariantMotion motion(func.get());
+        while (motion.run_once()) {}
+    }
+}
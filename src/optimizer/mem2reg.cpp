@@ -0,0 +1,59 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// mem2reg: promote the named slots IRBuilder reads and writes with LOAD/STORE.
+//
+// ToyC locals can never have their address taken, and construct_ssa has
+// already given every slot version a single definition, so
+//     STORE x.1, v      makes x.1 another name for v
+//     LOAD  t, x.1      makes t another name for x.1
+// Every use is rewritten to the value at the end of such a chain and the
+// LOAD/STORE instructions disappear. PHIs merging slot versions stay and now
+// merge the stored values directly.
+
+static std::string resolve(const std::unordered_map<std::string, std::string>& copies,
+                           const std::string& name) {
+    std::string value = name;
+    std::unordered_set<std::string> seen;
+    auto it = copies.find(value);
+    while (it != copies.end() && seen.insert(value).second) {
+        value = it->second;
+        it = copies.find(value);
+    }
+    return value;
+}
+
+static void promote_function(FunctionIR* func) {
+    // Slot version / loaded temp -> the value it copies
+    std::unordered_map<std::string, std::string> copies;
+    for (const auto& instr : func->instrs) {
+        if (instr.op == TacOp::STORE && is_variable(instr.dest)) {
+            copies[instr.dest] = instr.src1;
+        } else if (instr.op == TacOp::LOAD && is_variable(instr.dest) && is_variable(instr.src1)) {
+            copies[instr.dest] = instr.src1;
+        }
+    }
+    if (copies.empty()) return;
+
+    std::vector<TacInstr> instrs;
+    for (auto instr : func->instrs) {
+        if (instr_has_def(instr) && copies.count(instr.dest) &&
+            (instr.op == TacOp::STORE || instr.op == TacOp::LOAD)) {
+            continue;
+        }
+        for (std::string* slot : instr_use_slots(instr)) {
+            if (is_variable(*slot)) *slot = resolve(copies, *slot);
+        }
+        instrs.push_back(instr);
+    }
+    func->instrs = std::move(instrs);
+}
+
+void Optimizer::mem2reg(ProgramIR* program) {
+    for (auto& func : program->functions) {
+        promote_function(func.get());
+    }
+}
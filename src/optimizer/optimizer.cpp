@@ -1,32 +1,14 @@
 #include "optimizer/optimizer.h"
+#include "ir/cfg.h"
 #include <algorithm>
 #include <cctype>
 #include <unordered_set>
 
-// Check if a string is a number
-static bool is_number(const std::string& s) {
-    if (s.empty()) return false;
-    size_t i = 0;
-    if (s[0] == '-') {
-        if (s.length() == 1) return false;
-        i = 1;
-    }
-    for (; i < s.length(); i++) {
-        if (!isdigit(s[i])) return false;
-    }
-    return true;
-}
-
 // Convert string to long long
 static long long to_longlong(const std::string& s) {
     return std::stoll(s);
 }
 
-// Convert long long to string
-static std::string to_string_ll(long long v) {
-    return std::to_string(v);
-}
-
 // Check if a variable name (temporary)
 static bool is_temp_var(const std::string& var) {
     return !var.empty() && var[0] == '.';
@@ -34,10 +16,21 @@ static bool is_temp_var(const std::string& var) {
 
 void Optimizer::optimize(ProgramIR* program) {
     // Run optimizations in order
+    // The passes below track values by name, which is only sound once every
+    // name has a single definition
+    construct_ssa(program);
+    mem2reg(program);
     redundant_load_elimination(program);  // 首先消除冗余的LOAD
     copy_propagation(program);           // 然后消除冗余的MOVE
-    constant_propagation(program);
-    constant_folding(program);
+    tail_recursion_elimination(program); // 尾递归改写为循环
+    sccp(program);
+    gvn(program);                        // 复用支配路径上已算过的表达式
+    dead_code_elimination(program);
+    inline_functions(program);           // 内联小函数后重新跑一遍局部优化
+    sccp(program);
+    gvn(program);
+    licm(program);                       // 循环不变量外提
+    strength_reduction(program);         // 归纳变量强度削弱
     algebraic_simplification(program);
     dead_code_elimination(program);
 }
@@ -47,391 +40,63 @@ void Optimizer::process_function(FunctionIR* func) {
     (void)func;
 }
 
-void Optimizer::constant_propagation(ProgramIR* program) {
+void Optimizer::algebraic_simplification(ProgramIR* program) {
     for (auto& func : program->functions) {
-        std::unordered_map<std::string, long long> constants;
-
-        for (auto& instr : func->instrs) {
-            switch (instr.op) {
-                case TacOp::LOAD_IMM: {
-                    // LOAD_IMM dest, value -> dest = value
-                    if (is_number(instr.src1)) {
-                        constants[instr.dest] = to_longlong(instr.src1);
-                    }
-                    break;
-                }
-
-                case TacOp::ADD:
-                case TacOp::SUB:
-                case TacOp::MUL:
-                case TacOp::DIV:
-                case TacOp::MOD: {
-                    // Binary ops: dest = src1 op src2
-                    // Try to replace with constants
-                    long long const1 = 0, const2 = 0;
-                    bool has1 = is_number(instr.src1) ||
-                               (constants.find(instr.src1) != constants.end() &&
-                                !is_temp_var(instr.src1));
-                    bool has2 = is_number(instr.src2) ||
-                               (constants.find(instr.src2) != constants.end() &&
-                                !is_temp_var(instr.src2));
-
-                    if (has1) {
-                        if (is_number(instr.src1)) const1 = to_longlong(instr.src1);
-                        else if (constants.find(instr.src1) != constants.end())
-                            const1 = constants[instr.src1];
-                    }
-                    if (has2) {
-                        if (is_number(instr.src2)) const2 = to_longlong(instr.src2);
-                        else if (constants.find(instr.src2) != constants.end())
-                            const2 = constants[instr.src2];
-                    }
-
-                    if (has1 && has2) {
-                        // Both operands are constants, can fold
-                        long long result = 0;
-                        switch (instr.op) {
-                            case TacOp::ADD: result = const1 + const2; break;
-                            case TacOp::SUB: result = const1 - const2; break;
-                            case TacOp::MUL: result = const1 * const2; break;
-                            case TacOp::DIV: result = const1 / const2; break;
-                            case TacOp::MOD: result = const1 % const2; break;
-                            default: break;
-                        }
-                        // Replace with LOAD_IMM
-                        instr.op = TacOp::LOAD_IMM;
-                        instr.src1 = to_string_ll(result);
-                        instr.src2 = "";
-                        constants[instr.dest] = result;
-                    } else if (has1 && is_number(instr.src1)) {
-                        // First operand is a constant number
-                        // Keep as is for now
-                    } else if (has2 && is_number(instr.src2)) {
-                        // Second operand is a constant number
-                        // Keep as is for now
-                    }
-                    break;
-                }
-
-                case TacOp::STORE: {
-                    // STORE dest, src -> dest = src
-                    // If src is a constant, update the map
-                    if (constants.find(instr.src1) != constants.end()) {
-                        constants[instr.dest] = constants[instr.src1];
-                    } else if (is_number(instr.src1)) {
-                        constants[instr.dest] = to_longlong(instr.src1);
-                    }
-                    break;
-                }
-
-                case TacOp::MOVE: {
-                    // MOVE dest, src -> dest = src
-                    if (constants.find(instr.src1) != constants.end()) {
-                        constants[instr.dest] = constants[instr.src1];
-                    } else if (is_number(instr.src1)) {
-                        constants[instr.dest] = to_longlong(instr.src1);
-                    }
-                    break;
-                }
-
-                case TacOp::LOAD: {
-                    // LOAD dest, src -> dest = *src (we don't track pointer values)
-                    break;
-                }
-
-                default:
-                    break;
+        // Operands that are constant: literals and temps defined only by a LOAD_IMM
+        std::unordered_map<std::string, int> defs;
+        std::unordered_map<std::string, long long> loads;
+        for (const auto& instr : func->instrs) {
+            if (!instr_has_def(instr)) continue;
+            defs[instr.dest]++;
+            if (instr.op == TacOp::LOAD_IMM && is_number(instr.src1)) {
+                loads[instr.dest] = to_longlong(instr.src1);
             }
         }
-    }
-}
-
-void Optimizer::constant_folding(ProgramIR* program) {
-    for (auto& func : program->functions) {
-        std::unordered_map<std::string, long long> const_values;
-
+        std::unordered_map<std::string, long long> constants;
+        for (const auto& load : loads) {
+            if (defs[load.first] == 1) constants.insert(load);
+        }
         for (auto& instr : func->instrs) {
-            // First, propagate known constant values
-            if (instr.op == TacOp::LOAD_IMM && is_number(instr.src1)) {
-                const_values[instr.dest] = to_longlong(instr.src1);
-            }
-
-            // Try to fold the current instruction
-            try_fold_instruction(instr, const_values);
+            try_simplify_instruction(instr, constants);
         }
     }
 }
 
-bool Optimizer::try_fold_instruction(TacInstr& instr,
-                                      const std::unordered_map<std::string, long long>& constants) {
-    long long result = 0;
-    bool can_fold = false;
-
-    switch (instr.op) {
-        case TacOp::ADD: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-            }
-            if (has2) {
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-            }
-
-            if (has1 && has2) {
-                result = v1 + v2;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::SUB: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 - v2;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::MUL: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 * v2;
-                can_fold = true;
-            }
-            break;
+bool Optimizer::try_simplify_instruction(TacInstr& instr,
+                                         const std::unordered_map<std::string, long long>& constants) {
+    auto constant = [&](const std::string& operand, long long& value) {
+        if (is_number(operand)) {
+            value = to_longlong(operand);
+            return true;
         }
-
-        case TacOp::DIV: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                if (v2 != 0) {
-                    result = v1 / v2;
-                    can_fold = true;
-                }
-            }
-            break;
-        }
-
-        case TacOp::MOD: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                if (v2 != 0) {
-                    result = v1 % v2;
-                    can_fold = true;
-                }
-            }
-            break;
-        }
-
-        case TacOp::NOT: {
-            long long v = 0;
-            bool has = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            if (has) {
-                if (is_number(instr.src1)) v = to_longlong(instr.src1);
-                else v = constants.at(instr.src1);
-                result = v == 0 ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::LT: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 < v2 ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::GT: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 > v2 ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::LE: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 <= v2 ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::GE: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 >= v2 ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::EQ: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 == v2 ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::NE: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = v1 != v2 ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::AND: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = (v1 != 0 && v2 != 0) ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        case TacOp::OR: {
-            long long v1 = 0, v2 = 0;
-            bool has1 = is_number(instr.src1) || constants.find(instr.src1) != constants.end();
-            bool has2 = is_number(instr.src2) || constants.find(instr.src2) != constants.end();
-
-            if (has1 && has2) {
-                if (is_number(instr.src1)) v1 = to_longlong(instr.src1);
-                else v1 = constants.at(instr.src1);
-                if (is_number(instr.src2)) v2 = to_longlong(instr.src2);
-                else v2 = constants.at(instr.src2);
-                result = (v1 != 0 || v2 != 0) ? 1 : 0;
-                can_fold = true;
-            }
-            break;
-        }
-
-        default:
-            break;
-    }
-
-    if (can_fold) {
+        auto it = constants.find(operand);
+        if (it == constants.end()) return false;
+        value = it->second;
+        return true;
+    };
+    auto to_move = [&](const std::string& operand) {
+        instr.op = TacOp::MOVE;
+        instr.src1 = operand;
+        instr.src2 = "";
+    };
+    auto to_zero = [&]() {
         instr.op = TacOp::LOAD_IMM;
-        instr.src1 = to_string_ll(result);
+        instr.src1 = "0";
         instr.src2 = "";
-        return true;
-    }
-
-    return false;
-}
-
-void Optimizer::algebraic_simplification(ProgramIR* program) {
-    for (auto& func : program->functions) {
-        for (auto& instr : func->instrs) {
-            try_simplify_instruction(instr);
-        }
-    }
-}
+    };
+    long long a = 0, b = 0;
+    bool ka = constant(instr.src1, a);
+    bool kb = constant(instr.src2, b);
 
-bool Optimizer::try_simplify_instruction(TacInstr& instr) {
     switch (instr.op) {
         // x + 0 = x
         case TacOp::ADD: {
-            if (is_number(instr.src2) && to_longlong(instr.src2) == 0) {
-                instr.op = TacOp::MOVE;
-                instr.src2 = "";
+            if (kb && b == 0) {
+                to_move(instr.src1);
                 return true;
             }
-            if (is_number(instr.src1) && to_longlong(instr.src1) == 0) {
-                instr.op = TacOp::MOVE;
-                instr.src1 = instr.src2;
-                instr.src2 = "";
+            if (ka && a == 0) {
+                to_move(instr.src2);
                 return true;
             }
             break;
@@ -439,78 +104,75 @@ bool Optimizer::try_simplify_instruction(TacInstr& instr) {
 
         // x - 0 = x
         case TacOp::SUB: {
-            if (is_number(instr.src2) && to_longlong(instr.src2) == 0) {
-                instr.op = TacOp::MOVE;
-                instr.src2 = "";
+            if (kb && b == 0) {
+                to_move(instr.src1);
                 return true;
             }
             // x - x = 0
             if (instr.src1 == instr.src2) {
-                instr.op = TacOp::LOAD_IMM;
-                instr.src1 = "0";
-                instr.src2 = "";
+                to_zero();
                 return true;
             }
             break;
         }
 
-        // x * 1 = x
+        // x * 1 = x, x * 0 = 0, x * -1 = 0 - x, x * 2 = x + x; a constant
+        // factor goes to src2, where the backend turns it into a shift/add
+        // chain when that is cheaper than a mul on the target core
         case TacOp::MUL: {
-            if (is_number(instr.src2)) {
-                long long v = to_longlong(instr.src2);
-                if (v == 1) {
-                    instr.op = TacOp::MOVE;
-                    instr.src2 = "";
-                    return true;
-                }
-                if (v == 0) {
-                    instr.op = TacOp::LOAD_IMM;
-                    instr.src1 = "0";
-                    instr.src2 = "";
-                    return true;
-                }
+            bool swapped = ka && !kb;
+            if (swapped) {
+                std::swap(instr.src1, instr.src2);
+                std::swap(a, b);
+                std::swap(ka, kb);
+            }
+            if (!kb) break;
+            if (b == 1) {
+                to_move(instr.src1);
+                return true;
             }
-            if (is_number(instr.src1)) {
-                long long v = to_longlong(instr.src1);
-                if (v == 1) {
-                    instr.op = TacOp::MOVE;
-                    instr.src1 = instr.src2;
-                    instr.src2 = "";
-                    return true;
-                }
-                if (v == 0) {
-                    instr.op = TacOp::LOAD_IMM;
-                    instr.src1 = "0";
-                    instr.src2 = "";
-                    return true;
-                }
+            if (b == 0) {
+                to_zero();
+                return true;
             }
-            break;
+            if (b == -1) {
+                instr.op = TacOp::SUB;
+                instr.src2 = instr.src1;
+                instr.src1 = "0";
+                return true;
+            }
+            if (b == 2) {
+                instr.op = TacOp::ADD;
+                instr.src2 = instr.src1;
+                return true;
+            }
+            return swapped;
         }
 
-        // x / 1 = x
+        // x / 1 = x, x / -1 = 0 - x
         case TacOp::DIV: {
-            if (is_number(instr.src2) && to_longlong(instr.src2) == 1) {
-                instr.op = TacOp::MOVE;
-                instr.src2 = "";
+            if (kb && b == 1) {
+                to_move(instr.src1);
+                return true;
+            }
+            if (kb && b == -1) {
+                instr.op = TacOp::SUB;
+                instr.src2 = instr.src1;
+                instr.src1 = "0";
                 return true;
             }
             break;
         }
 
-        // x % 1 = 0
+        // x % 1 = x % -1 = 0
         case TacOp::MOD: {
-            if (is_number(instr.src2) && to_longlong(instr.src2) == 1) {
-                instr.op = TacOp::LOAD_IMM;
-                instr.src1 = "0";
-                instr.src2 = "";
+            if (kb && (b == 1 || b == -1)) {
+                to_zero();
                 return true;
             }
             break;
         }
 
-        // x * 0 = 0 (already handled in MUL above)
-
         default:
             break;
     }
@@ -523,15 +185,12 @@ void Optimizer::dead_code_elimination(ProgramIR* program) {
         // Track which temporaries are used
         std::unordered_set<std::string> used_temps;
 
-        // First pass: find all used temporaries
+        // First pass: find all used temporaries (PHI operands included)
         for (auto& instr : func->instrs) {
-            // Check src1
-            if (is_temp_var(instr.src1)) {
-                used_temps.insert(instr.src1);
-            }
-            // Check src2
-            if (is_temp_var(instr.src2)) {
-                used_temps.insert(instr.src2);
+            for (const std::string* slot : instr_use_slots(instr)) {
+                if (is_temp_var(*slot)) {
+                    used_temps.insert(*slot);
+                }
             }
             // For STORE, the dest (variable name) might be used later
             if (instr.op == TacOp::STORE && !is_temp_var(instr.dest)) {
@@ -551,8 +210,8 @@ void Optimizer::dead_code_elimination(ProgramIR* program) {
         for (auto& instr : func->instrs) {
             bool keep = true;
 
-            // Check if this instruction defines a temp
-            if (is_temp_var(instr.dest)) {
+            // Check if this instruction defines a temp; a call is kept for its side effects
+            if (is_temp_var(instr.dest) && instr.op != TacOp::CALL) {
                 // If this temp was already defined and not used in between, previous def is dead
                 // For now, just check if the current def is used later
                 if (used_temps.find(instr.dest) == used_temps.end()) {
@@ -596,18 +255,14 @@ void Optimizer::copy_propagation(ProgramIR* program) {
         std::unordered_map<std::string, std::string> copy_map;
         
         // 收集所有使用点
-        struct UsePoint {
-            TacInstr* instr;
-            int idx;  // 1 for src1, 2 for src2
-        };
-        std::vector<UsePoint> use_points;
+        // PHI的参数也是使用点
+        std::vector<std::string*> use_points;
         
         for (auto& instr : func->instrs) {
-            if (is_temp_var(instr.src1)) {
-                use_points.push_back({&instr, 1});
-            }
-            if (is_temp_var(instr.src2)) {
-                use_points.push_back({&instr, 2});
+            for (std::string* slot : instr_use_slots(instr)) {
+                if (is_temp_var(*slot)) {
+                    use_points.push_back(slot);
+                }
             }
         }
         
@@ -626,9 +281,8 @@ void Optimizer::copy_propagation(ProgramIR* program) {
             }
             
             // 第二遍：应用复制传播
-            for (auto& up : use_points) {
-                TacInstr* instr = up.instr;
-                std::string var = (up.idx == 1) ? instr->src1 : instr->src2;
+            for (std::string* up : use_points) {
+                std::string var = *up;
                 
                 // 尝试链式传播：.t2 -> .t1 -> .t0 应该变成 .t2 -> .t0
                 std::string source = var;
@@ -641,11 +295,7 @@ void Optimizer::copy_propagation(ProgramIR* program) {
                 
                 // 如果找到了最终的源
                 if (source != var) {
-                    if (up.idx == 1) {
-                        instr->src1 = source;
-                    } else {
-                        instr->src2 = source;
-                    }
+                    *up = source;
                     changed = true;
                 }
             }
@@ -656,8 +306,9 @@ void Optimizer::copy_propagation(ProgramIR* program) {
         for (auto& instr : func->instrs) {
             if (instr.op != TacOp::MOVE) {
                 // 收集所有使用的临时变量
-                if (is_temp_var(instr.src1)) used_temps.insert(instr.src1);
-                if (is_temp_var(instr.src2)) used_temps.insert(instr.src2);
+                for (const std::string* slot : instr_use_slots(instr)) {
+                    if (is_temp_var(*slot)) used_temps.insert(*slot);
+                }
             }
         }
         
@@ -12,20 +12,32 @@ public:
     static void optimize(ProgramIR* program);
 
     // Individual optimization passes
-    static void constant_propagation(ProgramIR* program);
-    static void constant_folding(ProgramIR* program);
     static void dead_code_elimination(ProgramIR* program);
     static void algebraic_simplification(ProgramIR* program);
     static void copy_propagation(ProgramIR* program);  // 消除冗余的MOVE指令
     static void redundant_load_elimination(ProgramIR* program);  // 消除冗余的LOAD
 
-private:
-    // Helper for constant folding a single instruction
-    static bool try_fold_instruction(TacInstr& instr,
-                                      const std::unordered_map<std::string, long long>& constants);
+    // SSA construction: pruned PHI placement on dominance frontiers + renaming
+    static void construct_ssa(ProgramIR* program);
+    // Promote LOAD/STORE on named slots to direct value flow (needs SSA form)
+    static void mem2reg(ProgramIR* program);
+    // Sparse conditional constant propagation with RV32 int semantics (needs SSA form)
+    static void sccp(ProgramIR* program);
+    // Dominator-scoped global value numbering / CSE (needs SSA form)
+    static void gvn(ProgramIR* program);
+    // Hoist loop-invariant instructions into loop preheaders (needs SSA form)
+    static void licm(ProgramIR* program);
+    // Induction-variable strength reduction + exit test replacement (needs SSA form)
+    static void strength_reduction(ProgramIR* program);
+    // Inline small non-recursive callees using a size/loop-depth cost model (needs SSA form)
+    static void inline_functions(ProgramIR* program);
+    // Turn self-calls in tail position into loops (needs SSA form)
+    static void tail_recursion_elimination(ProgramIR* program);
 
+private:
     // Helper for algebraic simplification
-    static bool try_simplify_instruction(TacInstr& instr);
+    static bool try_simplify_instruction(TacInstr& instr,
+                                         const std::unordered_map<std::string, long long>& constants);
 
     // Process a single function
     static void process_function(FunctionIR* func);
@@ -0,0 +1,346 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <climits>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Sparse conditional constant propagation (Wegman & Zadeck) on SSA form.
+//
+// Every SSA name starts at TOP (no value seen yet) and can only move down
+// to a constant and then to BOTTOM (not constant). Only blocks reached over
+// executable CFG edges are evaluated, and a PHI only meets the operands of
+// its executable incoming edges, so a branch on a constant keeps the dead
+// arm from polluting the join.
+//
+// Arithmetic follows RV32 exactly: 32-bit wraparound, x / 0 == -1,
+// x % 0 == x, INT_MIN / -1 == INT_MIN and INT_MIN % -1 == 0 (the results the
+// div/rem instructions produce), so folding never changes program output.
+//
+// Afterwards constant definitions become LOAD_IMM, constant branches become
+// JUMPs or disappear, and blocks that never became executable are deleted.
+
+namespace {
+
+struct LatticeValue {
+    enum Kind { TOP, CONST, BOTTOM } kind = TOP;
+    int32_t value = 0;
+
+    static LatticeValue constant(int32_t v) {
+        LatticeValue result;
+        result.kind = CONST;
+        result.value = v;
+        return result;
+    }
+    static LatticeValue bottom() {
+        LatticeValue result;
+        result.kind = BOTTOM;
+        return result;
+    }
+    bool operator==(const LatticeValue& other) const {
+        return kind == other.kind && (kind != CONST || value == other.value);
+    }
+    bool operator!=(const LatticeValue& other) const { return !(*this == other); }
+};
+
+LatticeValue meet(const LatticeValue& a, const LatticeValue& b) {
+    if (a.kind == LatticeValue::TOP) return b;
+    if (b.kind == LatticeValue::TOP) return a;
+    if (a.kind == LatticeValue::BOTTOM || b.kind == LatticeValue::BOTTOM) return LatticeValue::bottom();
+    return a.value == b.value ? a : LatticeValue::bottom();
+}
+
+// Literal as the 32-bit value the assembler will materialize
+int32_t wrap_literal(const std::string& s) {
+    return static_cast<int32_t>(static_cast<uint32_t>(std::stoll(s)));
+}
+
+int32_t eval_binary(TacOp op, int32_t a, int32_t b) {
+    uint32_t ua = static_cast<uint32_t>(a);
+    uint32_t ub = static_cast<uint32_t>(b);
+    switch (op) {
+        case TacOp::ADD: return static_cast<int32_t>(ua + ub);
+        case TacOp::SUB: return static_cast<int32_t>(ua - ub);
+        case TacOp::MUL: return static_cast<int32_t>(ua * ub);
+        case TacOp::DIV:
+            if (b == 0) return -1;
+            if (a == INT32_MIN && b == -1) return INT32_MIN;
+            return a / b;
+        case TacOp::MOD:
+            if (b == 0) return a;
+            if (a == INT32_MIN && b == -1) return 0;
+            return a % b;
+        case TacOp::AND: return (a != 0 && b != 0) ? 1 : 0;
+        case TacOp::OR:  return (a != 0 || b != 0) ? 1 : 0;
+        case TacOp::LT:  return a < b ? 1 : 0;
+        case TacOp::GT:  return a > b ? 1 : 0;
+        case TacOp::LE:  return a <= b ? 1 : 0;
+        case TacOp::GE:  return a >= b ? 1 : 0;
+        case TacOp::EQ:  return a == b ? 1 : 0;
+        case TacOp::NE:  return a != b ? 1 : 0;
+        default: return 0;
+    }
+}
+
+bool is_binary(TacOp op) {
+    switch (op) {
+        case TacOp::ADD: case TacOp::SUB: case TacOp::MUL: case TacOp::DIV: case TacOp::MOD:
+        case TacOp::AND: case TacOp::OR:
+        case TacOp::LT: case TacOp::GT: case TacOp::LE: case TacOp::GE: case TacOp::EQ: case TacOp::NE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct SCCPSolver {
+    FunctionIR* func;
+    std::unordered_map<std::string, int> label_block;
+    std::unordered_map<std::string, LatticeValue> values;
+    std::unordered_set<std::string> defined;        // names with exactly one definition
+    std::unordered_map<std::string, std::vector<std::pair<int, int>>> uses;  // name -> (block, instr)
+    std::vector<char> executable;
+    std::set<std::pair<int, int>> executable_edges;
+    std::vector<std::pair<int, int>> flow_worklist;
+    std::vector<std::string> ssa_worklist;
+
+    explicit SCCPSolver(FunctionIR* f) : func(f) {}
+
+    LatticeValue operand(const std::string& s) const {
+        if (is_number(s)) return LatticeValue::constant(wrap_literal(s));
+        if (!is_variable(s) || !defined.count(s)) return LatticeValue::bottom();
+        auto it = values.find(s);
+        return it == values.end() ? LatticeValue() : it->second;
+    }
+
+    void set_value(const std::string& name, const LatticeValue& v) {
+        if (!defined.count(name)) return;
+        LatticeValue& slot = values[name];
+        LatticeValue lowered = meet(slot, v);
+        if (lowered != slot) {
+            slot = lowered;
+            ssa_worklist.push_back(name);
+        }
+    }
+
+    void add_edge(int from, int to) {
+        flow_worklist.push_back({from, to});
+    }
+
+    int fallthrough_block(int b) const {
+        return b + 1 < (int)func->blocks.size() ? b + 1 : -1;
+    }
+
+    void visit_phi(int b, const TacInstr& phi) {
+        LatticeValue result;
+        for (const auto& arg : phi.phi_args) {
+            auto it = label_block.find(arg.first);
+            if (it == label_block.end() || !executable_edges.count({it->second, b})) continue;
+            result = meet(result, operand(arg.second));
+        }
+        set_value(phi.dest, result);
+    }
+
+    LatticeValue evaluate(const TacInstr& instr) const {
+        switch (instr.op) {
+            case TacOp::LOAD_IMM:
+                return is_number(instr.src1) ? LatticeValue::constant(wrap_literal(instr.src1))
+                                             : LatticeValue::bottom();
+            case TacOp::MOVE:
+            case TacOp::STORE:
+                return operand(instr.src1);
+            case TacOp::LOAD:
+                // Named slots are plain SSA values; "#s0:off" is a stack argument
+                return is_variable(instr.src1) ? operand(instr.src1) : LatticeValue::bottom();
+            case TacOp::NOT: {
+                LatticeValue v = operand(instr.src1);
+                if (v.kind != LatticeValue::CONST) return v;
+                return LatticeValue::constant(v.value == 0 ? 1 : 0);
+            }
+            default:
+                break;
+        }
+        if (!is_binary(instr.op)) return LatticeValue::bottom();
+
+        LatticeValue a = operand(instr.src1);
+        LatticeValue b = operand(instr.src2);
+        if (a.kind == LatticeValue::CONST && b.kind == LatticeValue::CONST) {
+            return LatticeValue::constant(eval_binary(instr.op, a.value, b.value));
+        }
+        // A known operand can decide the result on its own
+        auto is_const = [](const LatticeValue& v, int32_t c) {
+            return v.kind == LatticeValue::CONST && v.value == c;
+        };
+        if (instr.op == TacOp::MUL && (is_const(a, 0) || is_const(b, 0))) return LatticeValue::constant(0);
+        if (instr.op == TacOp::AND && (is_const(a, 0) || is_const(b, 0))) return LatticeValue::constant(0);
+        if (instr.op == TacOp::OR &&
+            ((a.kind == LatticeValue::CONST && a.value != 0) || (b.kind == LatticeValue::CONST && b.value != 0))) {
+            return LatticeValue::constant(1);
+        }
+        if (a.kind == LatticeValue::TOP || b.kind == LatticeValue::TOP) return LatticeValue();
+        return LatticeValue::bottom();
+    }
+
+    void visit_instr(int b, const TacInstr& instr) {
+        if (instr.op == TacOp::PHI) {
+            visit_phi(b, instr);
+            return;
+        }
+        if (instr.op == TacOp::BEQZ || instr.op == TacOp::BNEZ) {
+            int target = label_block.count(instr.src2) ? label_block[instr.src2] : -1;
+            int fall = fallthrough_block(b);
+            LatticeValue cond = operand(instr.src1);
+            if (cond.kind == LatticeValue::TOP) return;
+            if (cond.kind == LatticeValue::BOTTOM) {
+                if (target != -1) add_edge(b, target);
+                if (fall != -1) add_edge(b, fall);
+                return;
+            }
+            bool taken = (instr.op == TacOp::BEQZ) == (cond.value == 0);
+            int next = taken ? target : fall;
+            if (next != -1) add_edge(b, next);
+            return;
+        }
+        if (instr.op == TacOp::JUMP) {
+            if (label_block.count(instr.src2)) add_edge(b, label_block[instr.src2]);
+            return;
+        }
+        if (instr_has_def(instr) && is_variable(instr.dest)) {
+            set_value(instr.dest, evaluate(instr));
+        }
+    }
+
+    void visit_block(int b) {
+        const BasicBlock& block = func->blocks[b];
+        for (const auto& instr : block.instrs) {
+            visit_instr(b, instr);
+        }
+        TacOp last = block.instrs.back().op;
+        if (!is_terminator(last)) {
+            int fall = fallthrough_block(b);
+            if (fall != -1) add_edge(b, fall);
+        }
+    }
+
+    void solve() {
+        std::unordered_map<std::string, int> def_count;
+        for (int b = 0; b < (int)func->blocks.size(); b++) {
+            const BasicBlock& block = func->blocks[b];
+            if (!block.label.empty()) label_block[block.label] = b;
+            for (int i = 0; i < (int)block.instrs.size(); i++) {
+                const TacInstr& instr = block.instrs[i];
+                if (instr_has_def(instr) && is_variable(instr.dest)) def_count[instr.dest]++;
+                for (const std::string* slot : instr_use_slots(instr)) {
+                    if (is_variable(*slot)) uses[*slot].push_back({b, i});
+                }
+            }
+        }
+        // Not in SSA form: leave names with several definitions alone
+        for (const auto& entry : def_count) {
+            if (entry.second == 1) defined.insert(entry.first);
+        }
+
+        executable.assign(func->blocks.size(), 0);
+        executable[0] = 1;
+        visit_block(0);
+
+        while (!flow_worklist.empty() || !ssa_worklist.empty()) {
+            while (!flow_worklist.empty()) {
+                std::pair<int, int> edge = flow_worklist.back();
+                flow_worklist.pop_back();
+                if (!executable_edges.insert(edge).second) continue;
+                int b = edge.second;
+                if (!executable[b]) {
+                    executable[b] = 1;
+                    visit_block(b);
+                } else {
+                    // A new incoming edge only affects the PHIs
+                    for (const auto& instr : func->blocks[b].instrs) {
+                        if (instr.op == TacOp::PHI) visit_phi(b, instr);
+                    }
+                }
+            }
+            while (!ssa_worklist.empty()) {
+                std::string name = ssa_worklist.back();
+                ssa_worklist.pop_back();
+                for (const auto& use : uses[name]) {
+                    if (executable[use.first]) {
+                        visit_instr(use.first, func->blocks[use.first].instrs[use.second]);
+                    }
+                }
+            }
+        }
+    }
+
+    void rewrite() {
+        std::vector<BasicBlock> kept;
+        for (int b = 0; b < (int)func->blocks.size(); b++) {
+            if (!executable[b]) continue;
+            BasicBlock block = func->blocks[b];
+            std::vector<TacInstr> instrs;
+            std::vector<TacInstr> after_phis;  // PHIs that turned into plain copies
+
+            for (auto instr : block.instrs) {
+                if (instr.op == TacOp::PHI) {
+                    std::vector<std::pair<std::string, std::string>> args;
+                    for (const auto& arg : instr.phi_args) {
+                        auto it = label_block.find(arg.first);
+                        if (it != label_block.end() && executable_edges.count({it->second, b})) {
+                            args.push_back(arg);
+                        }
+                    }
+                    instr.phi_args = std::move(args);
+                    LatticeValue v = operand(instr.dest);
+                    if (v.kind == LatticeValue::CONST) {
+                        after_phis.emplace_back(TacOp::LOAD_IMM, instr.dest, std::to_string(v.value));
+                    } else if (instr.phi_args.size() == 1) {
+                        after_phis.emplace_back(TacOp::MOVE, instr.dest, instr.phi_args[0].second);
+                    } else {
+                        instrs.push_back(instr);
+                    }
+                    continue;
+                }
+                if (!after_phis.empty() && instr.op != TacOp::LABEL) {
+                    instrs.insert(instrs.end(), after_phis.begin(), after_phis.end());
+                    after_phis.clear();
+                }
+
+                if (instr.op == TacOp::BEQZ || instr.op == TacOp::BNEZ) {
+                    LatticeValue cond = operand(instr.src1);
+                    if (cond.kind == LatticeValue::CONST) {
+                        bool taken = (instr.op == TacOp::BEQZ) == (cond.value == 0);
+                        if (taken) instrs.emplace_back(TacOp::JUMP, "", "", instr.src2);
+                        continue;
+                    }
+                }
+                if (instr.op != TacOp::CALL && instr.op != TacOp::LOAD_IMM &&
+                    instr_has_def(instr) && is_variable(instr.dest)) {
+                    LatticeValue v = operand(instr.dest);
+                    if (v.kind == LatticeValue::CONST) {
+                        instr = TacInstr(TacOp::LOAD_IMM, instr.dest, std::to_string(v.value));
+                    }
+                }
+                instrs.push_back(instr);
+            }
+            instrs.insert(instrs.end(), after_phis.begin(), after_phis.end());
+            block.instrs = std::move(instrs);
+            kept.push_back(std::move(block));
+        }
+        func->blocks = std::move(kept);
+        func->flatten_blocks();
+    }
+};
+
+} // namespace
+
+void Optimizer::sccp(ProgramIR* program) {
+    for (auto& func : program->functions) {
+        func->build_cfg();
+        if (func->blocks.empty()) continue;
+        SCCPSolver solver(func.get());
+        solver.solve();
+        solver.rewrite();
+    }
+}
@@ -0,0 +1,179 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// SSA construction (Cytron et al.) on top of FunctionIR::build_cfg.
+//
+// Every variable the function writes is renamed, including the named slots
+// that IRBuilder accesses with LOAD/STORE: ToyC locals can never have their
+// address taken, so a STORE is simply a definition of the slot and a LOAD a
+// use. PHIs are pruned with the block liveness from compute_liveness, so a
+// PHI for v is only placed at a join where v is live on entry.
+//
+// Versions are named "<var>.<n>"; '.' cannot appear in a ToyC identifier, and
+// temps / scoped names keep their leading '.' or base name so the allocator's
+// temp-vs-user-variable heuristics still apply.
+
+namespace {
+
+struct SSARenamer {
+    FunctionIR* func;
+    std::unordered_set<std::string> vars;
+    std::unordered_map<std::string, std::vector<std::string>> stacks;
+    std::unordered_map<std::string, int> counters;
+    // Original variable of each PHI, keyed by block index then PHI position
+    std::vector<std::unordered_map<size_t, std::string>> phi_vars;
+
+    std::string new_name(const std::string& var) {
+        return var + "." + std::to_string(++counters[var]);
+    }
+
+    std::string current(const std::string& var) const {
+        auto it = stacks.find(var);
+        if (it == stacks.end() || it->second.empty()) return "";
+        return it->second.back();
+    }
+
+    void rename(int b) {
+        BasicBlock& block = func->blocks[b];
+        std::vector<std::string> pushed;
+
+        for (auto& instr : block.instrs) {
+            if (instr.op != TacOp::PHI) {
+                for (std::string* slot : instr_use_slots(instr)) {
+                    if (!vars.count(*slot)) continue;
+                    std::string name = current(*slot);
+                    if (!name.empty()) *slot = name;
+                }
+            }
+            if (instr_has_def(instr) && vars.count(instr.dest)) {
+                std::string var = instr.dest;
+                instr.dest = new_name(var);
+                stacks[var].push_back(instr.dest);
+                pushed.push_back(var);
+            }
+        }
+
+        // Fill in the PHI operands flowing along each outgoing edge
+        for (const auto& succ_name : block.successors) {
+            int s = func->block_index[succ_name];
+            BasicBlock& succ = func->blocks[s];
+            for (size_t i = 0; i < succ.instrs.size(); i++) {
+                TacInstr& phi = succ.instrs[i];
+                if (phi.op == TacOp::LABEL) continue;
+                if (phi.op != TacOp::PHI) break;
+                const std::string& var = phi_vars[s][i];
+                for (auto& arg : phi.phi_args) {
+                    if (arg.first != block.label) continue;
+                    std::string name = current(var);
+                    // No definition reaches this edge: the value is undefined
+                    arg.second = name.empty() ? "0" : name;
+                }
+            }
+        }
+
+        // Recurse over the dominator tree
+        for (const auto& child : block.dom_children) {
+            rename(func->block_index[child]);
+        }
+
+        for (const auto& var : pushed) {
+            stacks[var].pop_back();
+        }
+    }
+};
+
+} // namespace
+
+static void construct_function_ssa(FunctionIR* func) {
+    func->build_cfg();
+    if (func->blocks.empty()) return;
+
+    // The entry block must not be a join point: give loops that start the
+    // function a fresh entry block to come from
+    if (!func->blocks[0].predecessors.empty()) {
+        func->instrs.insert(func->instrs.begin(), TacInstr(TacOp::LABEL, "", "", func->next_label()));
+        func->build_cfg();
+    }
+    func->label_all_blocks();
+    func->remove_unreachable_blocks();
+    func->compute_liveness();
+    func->compute_dominators();
+
+    SSARenamer renamer;
+    renamer.func = func;
+    renamer.phi_vars.resize(func->blocks.size());
+
+    // Collect variables and the blocks that define them
+    std::unordered_map<std::string, std::vector<int>> def_blocks;
+    std::unordered_map<std::string, int> def_count;
+    for (int b = 0; b < (int)func->blocks.size(); b++) {
+        for (const auto& instr : func->blocks[b].instrs) {
+            if (!instr_has_def(instr) || !is_variable(instr.dest)) continue;
+            renamer.vars.insert(instr.dest);
+            def_count[instr.dest]++;
+            auto& sites = def_blocks[instr.dest];
+            if (sites.empty() || sites.back() != b) sites.push_back(b);
+        }
+    }
+
+    // Place pruned PHIs on the iterated dominance frontier of each variable
+    std::vector<std::vector<std::string>> block_phis(func->blocks.size());
+    for (const auto& entry : def_blocks) {
+        const std::string& var = entry.first;
+        std::vector<char> has_phi(func->blocks.size(), 0);
+        std::vector<char> queued(func->blocks.size(), 0);
+        std::vector<int> worklist = entry.second;
+        for (int b : worklist) queued[b] = 1;
+
+        while (!worklist.empty()) {
+            int b = worklist.back();
+            worklist.pop_back();
+            for (const auto& df_name : func->blocks[b].dom_frontier) {
+                int y = func->block_index[df_name];
+                if (has_phi[y] || !func->blocks[y].live_in.count(var)) continue;
+                has_phi[y] = 1;
+                block_phis[y].push_back(var);
+                if (!queued[y]) {
+                    queued[y] = 1;
+                    worklist.push_back(y);
+                }
+            }
+        }
+    }
+
+    std::unordered_set<std::string> has_phis;
+    for (int b = 0; b < (int)func->blocks.size(); b++) {
+        BasicBlock& block = func->blocks[b];
+        size_t pos = 1;  // right after the block label
+        for (const auto& var : block_phis[b]) {
+            has_phis.insert(var);
+            TacInstr phi(TacOp::PHI, var);
+            for (const auto& pred_name : block.predecessors) {
+                phi.phi_args.push_back({func->blocks[func->block_index[pred_name]].label, var});
+            }
+            renamer.phi_vars[b][pos] = var;
+            block.instrs.insert(block.instrs.begin() + pos, phi);
+            pos++;
+        }
+    }
+
+    // A variable with a single definition and no PHI is already in SSA form;
+    // keeping its name leaves most temps untouched
+    for (const auto& entry : def_count) {
+        if (entry.second == 1 && !has_phis.count(entry.first)) {
+            renamer.vars.erase(entry.first);
+        }
+    }
+
+    renamer.rename(0);
+    func->flatten_blocks();
+}
+
+void Optimizer::construct_ssa(ProgramIR* program) {
+    for (auto& func : program->functions) {
+        construct_function_ssa(func.get());
+    }
+}
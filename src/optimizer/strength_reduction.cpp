@@ -0,0 +1,468 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Induction-variable strength reduction and linear function test replacement
+// on SSA form, in the style of Cooper, Simpson & Vick's OSR.
+//
+// An induction variable (IV) is a header PHI
+//     p    = PHI [preheader: init] [latches: next]
+//     next = p + step   (or p - step)
+// with init and step loop-invariant ("region constants"). A multiply of an
+// IV by a region constant, x = p * rc, becomes a new IV
+//     q    = PHI [preheader: init * rc] [latches: next']
+//     next'= q + step * rc
+// and x is replaced by q (or by next' when it multiplied next). An ADD/SUB
+// of an IV and a region constant that feeds such a multiply is reduced the
+// same way first, so (j + c) * a or valA * (k + 2) lose their MULs. The new
+// start value and stride are computed once in the preheader. Wraparound is
+// harmless here: the recurrences hold modulo 2^32.
+//
+// The header's exit test "p < bound" is then rewritten to use a reduced IV
+// q = p * s + o (s, o constants) instead of p. A comparison only survives
+// that mapping if no value involved wraps, so the test is replaced only when
+// the start value, step and bound are constants and the whole range is
+// checked to fit in 32 bits. An IV left with no use outside its own
+// PHI/update cycle is deleted.
+
+namespace {
+
+int32_t wrap(long long v) {
+    return static_cast<int32_t>(static_cast<uint32_t>(v));
+}
+
+bool fits_int32(long long v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+struct InductionVariable {
+    std::string phi;
+    std::string next;
+    std::string init;
+    std::string step;
+    TacOp update = TacOp::ADD;  // next = phi ADD/SUB step
+};
+
+// An IV operand: the PHI itself or its post-increment value
+struct IVUse {
+    InductionVariable iv;
+    bool is_next = false;
+};
+
+// q = base * scale + offset for IVs derived with constant factors
+struct Affine {
+    std::string base;
+    long long scale = 1;
+    long long offset = 0;
+};
+
+struct StrengthReduction {
+    FunctionIR* func;
+    std::unordered_map<std::string, int> def_count;
+    std::unordered_map<std::string, int> def_block;
+    std::unordered_map<std::string, std::string> constants;  // LOAD_IMM dest -> literal
+    std::unordered_map<std::string, std::string> reduced;    // (op, iv, rc) -> new IV PHI
+    std::unordered_set<std::string> derived;                 // PHIs created here
+    std::map<std::string, Affine> affine;                    // derived IV PHI -> relation
+    std::unordered_map<std::string, int> label_block;
+
+    // Current loop
+    int header = -1;
+    int preheader = -1;
+    std::set<int> body;
+
+    explicit StrengthReduction(FunctionIR* f) : func(f) {}
+
+    void collect_defs() {
+        for (int b = 0; b < (int)func->blocks.size(); b++) {
+            for (const auto& instr : func->blocks[b].instrs) {
+                if (!instr_has_def(instr) || !is_variable(instr.dest)) continue;
+                def_count[instr.dest]++;
+                def_block[instr.dest] = b;
+                if (instr.op == TacOp::LOAD_IMM && is_number(instr.src1)) constants[instr.dest] = instr.src1;
+            }
+        }
+    }
+
+    bool constant_value(const std::string& s, long long& value) const {
+        if (is_number(s)) {
+            value = std::stoll(s);
+            return true;
+        }
+        auto it = constants.find(s);
+        if (it == constants.end()) return false;
+        value = std::stoll(it->second);
+        return true;
+    }
+
+    bool single_def(const std::string& s) const {
+        auto it = def_count.find(s);
+        return it != def_count.end() && it->second == 1;
+    }
+
+    bool region_constant(const std::string& s) const {
+        if (is_number(s)) return true;
+        return is_variable(s) && single_def(s) && !body.count(def_block.at(s));
+    }
+
+    // Position of the single definition of name, or nullptr
+    TacInstr* find_def(const std::string& name, int* index = nullptr) {
+        if (!single_def(name)) return nullptr;
+        auto& instrs = func->blocks[def_block[name]].instrs;
+        for (int i = 0; i < (int)instrs.size(); i++) {
+            if (instrs[i].dest == name && instr_has_def(instrs[i])) {
+                if (index) *index = i;
+                return &instrs[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void erase_def(const std::string& name) {
+        int index = -1;
+        if (!find_def(name, &index)) return;
+        auto& instrs = func->blocks[def_block[name]].instrs;
+        instrs.erase(instrs.begin() + index);
+        def_count.erase(name);
+        def_block.erase(name);
+    }
+
+    void add_def(const std::string& name, int block) {
+        def_count[name] = 1;
+        def_block[name] = block;
+    }
+
+    void rename(const std::string& from, const std::string& to) {
+        for (auto& block : func->blocks) {
+            for (auto& instr : block.instrs) {
+                for (std::string* slot : instr_use_slots(instr)) {
+                    if (*slot == from) *slot = to;
+                }
+            }
+        }
+    }
+
+    bool match_iv(const std::string& phi, InductionVariable& iv) {
+        if (!single_def(phi) || def_block[phi] != header) return false;
+        TacInstr* def = find_def(phi);
+        if (!def || def->op != TacOp::PHI) return false;
+
+        std::string init, next;
+        for (const auto& arg : def->phi_args) {
+            auto pred = label_block.find(arg.first);
+            if (pred == label_block.end()) return false;
+            bool inside = body.count(pred->second) > 0;
+            std::string& slot = inside ? next : init;
+            if (!slot.empty() && slot != arg.second) return false;
+            slot = arg.second;
+        }
+        if (init.empty() || next.empty() || !region_constant(init)) return false;
+
+        TacInstr* update = find_def(next);
+        if (!update || !body.count(def_block[next])) return false;
+        if (update->op == TacOp::ADD && update->src1 == phi && region_constant(update->src2)) {
+            iv.step = update->src2;
+        } else if (update->op == TacOp::ADD && update->src2 == phi && region_constant(update->src1)) {
+            iv.step = update->src1;
+        } else if (update->op == TacOp::SUB && update->src1 == phi && region_constant(update->src2)) {
+            iv.step = update->src2;
+        } else {
+            return false;
+        }
+        iv.phi = phi;
+        iv.next = next;
+        iv.init = init;
+        iv.update = update->op;
+        return true;
+    }
+
+    // Emit op(a, b) at the end of the preheader, folding constants
+    std::string emit_in_preheader(TacOp op, const std::string& a, const std::string& b) {
+        long long ca = 0, cb = 0;
+        bool ka = constant_value(a, ca), kb = constant_value(b, cb);
+        std::string operand;
+        if (op == TacOp::MUL && ka && ca == 1) operand = b;
+        if (op == TacOp::ADD && ka && ca == 0) operand = b;
+        if ((op == TacOp::MUL && kb && cb == 1) || (op != TacOp::MUL && kb && cb == 0)) operand = a;
+        if (!operand.empty() && !is_number(operand)) return operand;
+
+        TacInstr instr(op, func->next_temp(), a, b);
+        bool zero = op == TacOp::MUL && ((ka && ca == 0) || (kb && cb == 0));
+        if ((ka && kb) || zero) {
+            long long v = zero ? 0 : op == TacOp::MUL ? ca * cb : op == TacOp::ADD ? ca + cb : ca - cb;
+            instr = TacInstr(TacOp::LOAD_IMM, instr.dest, std::to_string(wrap(v)));
+            constants[instr.dest] = instr.src1;
+        }
+        auto& instrs = func->blocks[preheader].instrs;
+        auto pos = instrs.end();
+        if (!instrs.empty() && is_terminator(instrs.back().op)) --pos;
+        instrs.insert(pos, instr);
+        add_def(instr.dest, preheader);
+        return instr.dest;
+    }
+
+    // The IV computing op(iv, rc), created on first request
+    InductionVariable reduce(TacOp op, const InductionVariable& iv, const std::string& rc) {
+        std::string key = std::to_string(static_cast<int>(op)) + " " + iv.phi + " " + rc;
+        InductionVariable result;
+        auto it = reduced.find(key);
+        if (it != reduced.end() && match_iv(it->second, result)) return result;
+
+        result.init = emit_in_preheader(op, iv.init, rc);
+        result.step = op == TacOp::MUL ? emit_in_preheader(TacOp::MUL, iv.step, rc) : iv.step;
+        result.update = iv.update;
+        result.phi = func->next_temp();
+        result.next = func->next_temp();
+
+        // New PHI after the header's PHIs, fed like the original one
+        TacInstr phi(TacOp::PHI, result.phi);
+        for (const auto& arg : find_def(iv.phi)->phi_args) {
+            phi.phi_args.push_back({arg.first, arg.second == iv.init ? result.init : result.next});
+        }
+        auto& head = func->blocks[header].instrs;
+        size_t phi_pos = 0;
+        while (phi_pos < head.size() && (head[phi_pos].op == TacOp::LABEL || head[phi_pos].op == TacOp::PHI)) {
+            phi_pos++;
+        }
+        head.insert(head.begin() + phi_pos, phi);
+        add_def(result.phi, header);
+
+        // Update right after the original one
+        int next_index = -1;
+        find_def(iv.next, &next_index);
+        int next_block = def_block[iv.next];
+        auto& instrs = func->blocks[next_block].instrs;
+        instrs.insert(instrs.begin() + next_index + 1, TacInstr(iv.update, result.next, result.phi, result.step));
+        add_def(result.next, next_block);
+        derived.insert(result.phi);
+
+        // Derived IVs without a constant relation to a basic IV have no entry
+        auto base = affine.find(iv.phi);
+        Affine rel = base != affine.end() ? base->second : Affine{iv.phi, 1, 0};
+        long long c = 0;
+        if (constant_value(rc, c) && (base != affine.end() || !derived.count(iv.phi))) {
+            if (op == TacOp::MUL) {
+                rel.scale *= c;
+                rel.offset *= c;
+            } else {
+                rel.offset += op == TacOp::ADD ? c : -c;
+            }
+            if (fits_int32(rel.scale) && fits_int32(rel.offset)) affine[result.phi] = rel;
+        }
+
+        reduced[key] = result.phi;
+        return result;
+    }
+
+    // name as an IV of the current loop, reducing ADD/SUB chains on the way
+    bool iv_use(const std::string& name, IVUse& use, int depth = 0) {
+        if (!is_variable(name) || !single_def(name) || depth > 16) return false;
+        if (match_iv(name, use.iv)) {
+            use.is_next = false;
+            return true;
+        }
+        if (!body.count(def_block[name])) return false;
+        TacInstr* def = find_def(name);
+        if (!def || (def->op != TacOp::ADD && def->op != TacOp::SUB)) return false;
+
+        TacOp op = def->op;
+        std::string a = def->src1, b = def->src2;
+        for (const std::string& candidate : {a, b}) {
+            InductionVariable iv;
+            if (match_iv(candidate, iv) && iv.next == name) {
+                use.iv = iv;
+                use.is_next = true;
+                return true;
+            }
+        }
+
+        IVUse inner;
+        std::string rc;
+        if (region_constant(b) && iv_use(a, inner, depth + 1)) {
+            rc = b;
+        } else if (op == TacOp::ADD && region_constant(a) && iv_use(b, inner, depth + 1)) {
+            rc = a;
+        } else {
+            return false;
+        }
+        InductionVariable reduced_iv = reduce(op, inner.iv, rc);
+        std::string value = inner.is_next ? reduced_iv.next : reduced_iv.phi;
+        erase_def(name);
+        rename(name, value);
+        use.iv = reduced_iv;
+        use.is_next = inner.is_next;
+        return true;
+    }
+
+    void reduce_multiplies() {
+        std::vector<std::string> candidates;
+        for (int b : func->reverse_post_order()) {
+            if (!body.count(b)) continue;
+            for (const auto& instr : func->blocks[b].instrs) {
+                if (instr.op == TacOp::MUL && is_variable(instr.dest) && single_def(instr.dest)) {
+                    candidates.push_back(instr.dest);
+                }
+            }
+        }
+        for (const auto& name : candidates) {
+            TacInstr* def = find_def(name);
+            if (!def || def->op != TacOp::MUL) continue;
+            std::string a = def->src1, b = def->src2;
+
+            IVUse use;
+            std::string rc;
+            if (region_constant(b) && iv_use(a, use)) {
+                rc = b;
+            } else if (region_constant(a) && iv_use(b, use)) {
+                rc = a;
+            } else {
+                continue;
+            }
+            InductionVariable reduced_iv = reduce(TacOp::MUL, use.iv, rc);
+            erase_def(name);
+            rename(name, use.is_next ? reduced_iv.next : reduced_iv.phi);
+        }
+    }
+
+    int count_uses(const std::string& name, const std::string& except_def) const {
+        int uses = 0;
+        for (const auto& block : func->blocks) {
+            for (const auto& instr : block.instrs) {
+                if (instr.dest == except_def && instr_has_def(instr)) continue;
+                for (const std::string* slot : instr_use_slots(instr)) {
+                    if (*slot == name) uses++;
+                }
+            }
+        }
+        return uses;
+    }
+
+    // Replace the header's exit test "p < bound" by the same test on a
+    // reduced IV p * s + o. Only the test that ends the loop bounds the range
+    // p runs through, which is what makes the mapping wrap-free.
+    void replace_exit_test() {
+        auto& instrs = func->blocks[header].instrs;
+        if (instrs.size() < 2) return;
+        const TacInstr& branch = instrs.back();
+        if (branch.op != TacOp::BEQZ) return;
+        int target = -1;
+        for (const auto& succ : func->blocks[header].successors) {
+            if (func->blocks[func->block_index[succ]].label == branch.src2) target = func->block_index[succ];
+        }
+        if (target < 0 || body.count(target)) return;
+
+        for (auto& instr : instrs) {
+            if (instr.dest != branch.src1 || !instr_has_def(instr)) continue;
+            if (instr.op != TacOp::LT && instr.op != TacOp::LE && instr.op != TacOp::GT && instr.op != TacOp::GE) {
+                return;
+            }
+            if (!replace_test(instr.op, true, instr.src1, instr.src2)) {
+                replace_test(instr.op, false, instr.src2, instr.src1);
+            }
+            return;
+        }
+    }
+
+    bool replace_test(TacOp op, bool iv_on_left, std::string& iv_slot, std::string& bound_slot) {
+        long long bound = 0, init = 0, step = 0;
+        InductionVariable iv;
+        if (!constant_value(bound_slot, bound) || !match_iv(iv_slot, iv) || derived.count(iv.phi)) return false;
+        if (!constant_value(iv.init, init) || !constant_value(iv.step, step)) return false;
+        if (iv.update == TacOp::SUB) step = -step;
+
+        // The loop runs while the IV moves toward the bound, so p stays in [lo, hi]
+        bool less = (op == TacOp::LT || op == TacOp::LE) == iv_on_left;
+        if (step == 0 || (step > 0) != less) return false;
+        long long span = step < 0 ? -step : step;
+        long long lo = std::min(init, bound) - span;
+        long long hi = std::max(init, bound) + span;
+        if (!fits_int32(lo) || !fits_int32(hi)) return false;
+
+        for (const auto& entry : affine) {
+            const Affine& rel = entry.second;
+            if (rel.base != iv.phi || rel.scale <= 0) continue;
+            if (!fits_int32(lo * rel.scale + rel.offset) || !fits_int32(hi * rel.scale + rel.offset)) continue;
+            InductionVariable reduced_iv;
+            if (!match_iv(entry.first, reduced_iv)) continue;
+            if (count_uses(reduced_iv.phi, reduced_iv.next) + count_uses(reduced_iv.next, reduced_iv.phi) == 0) {
+                continue;
+            }
+            iv_slot = reduced_iv.phi;
+            bound_slot = emit_in_preheader(TacOp::ADD, std::to_string(bound * rel.scale),
+                                           std::to_string(rel.offset));
+            return true;
+        }
+        return false;
+    }
+
+    // Delete IVs whose PHI and update only feed each other
+    void remove_dead_ivs() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& instr : func->blocks[header].instrs) {
+                if (instr.op != TacOp::PHI) continue;
+                InductionVariable iv;
+                if (!match_iv(instr.dest, iv)) continue;
+                if (count_uses(iv.phi, iv.next) == 0 && count_uses(iv.next, iv.phi) == 0) {
+                    erase_def(iv.next);
+                    erase_def(iv.phi);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    void run() {
+        func->build_cfg();
+        func->label_all_blocks();
+        func->compute_dominators();
+        collect_defs();
+        for (int b = 0; b < (int)func->blocks.size(); b++) {
+            label_block[func->blocks[b].label] = b;
+        }
+
+        auto natural = func->natural_loops();
+        std::vector<std::pair<int, std::set<int>>> loops(natural.begin(), natural.end());
+        std::sort(loops.begin(), loops.end(), [](const auto& a, const auto& b) {
+            if (a.second.size() != b.second.size()) return a.second.size() < b.second.size();
+            return a.first < b.first;
+        });
+
+        for (const auto& loop : loops) {
+            header = loop.first;
+            body = loop.second;
+            preheader = -1;
+            std::vector<int> outside;
+            for (const auto& pred_name : func->blocks[header].predecessors) {
+                int p = func->block_index[pred_name];
+                if (!body.count(p)) outside.push_back(p);
+            }
+            if (outside.size() != 1 || func->blocks[outside[0]].successors.size() != 1) continue;
+            preheader = outside[0];
+
+            reduce_multiplies();
+            replace_exit_test();
+            remove_dead_ivs();
+        }
+        func->flatten_blocks();
+    }
+};
+
+} // namespace
+
+void Optimizer::strength_reduction(ProgramIR* program) {
+    for (auto& func : program->functions) {
+        func->build_cfg();
+        if (func->blocks.empty()) continue;
+        StrengthReduction pass(func.get());
+        pass.run();
+    }
+}
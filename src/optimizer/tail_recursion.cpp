@@ -0,0 +1,156 @@
+#include "optimizer/optimizer.h"
+#include "ir/cfg.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Tail-recursion elimination on SSA form.
+//
+// A self-call in tail position
+//     PARAM a0, x; PARAM a1, y; CALL r, f; MOVE a0, r; RET
+// (or CALL; RET, or a CALL falling off the end, for void functions) is
+// replaced by a jump back to a new loop header placed right after the
+// LOAD_PARAM prologue. The header has a PHI
+// per parameter that merges the incoming argument with the values passed at
+// each tail call, and every later use of the parameter reads that PHI:
+//
+//     entry: LOAD_PARAM p, a0          entry: LOAD_PARAM p, a0
+//            ...                 =>    H:     p' = PHI [entry: p] [tail: x]
+//     tail:  PARAM a0, x                      ... (uses of p read p')
+//            CALL r, f                 tail:  JUMP H
+//            MOVE a0, r; RET
+//
+// The recursion becomes an ordinary natural loop that LICM and strength
+// reduction can work on, and no longer grows the stack.
+
+namespace {
+
+struct TailCall {
+    int block;
+    std::vector<std::string> args;
+};
+
+void eliminate_tail_calls(ProgramIR* program, FunctionIR* func) {
+    func->build_cfg();
+    if (func->blocks.empty()) return;
+    func->label_all_blocks();
+
+    // The prologue: the entry label and the parameter loads right after it.
+    // A parameter read anywhere else would not see the new arguments.
+    auto& entry = func->blocks[0].instrs;
+    size_t first = entry.empty() || entry[0].op != TacOp::LABEL ? 0 : 1;
+    size_t prologue = first;
+    std::unordered_map<int, std::string> loaded;  // parameter index -> loaded name
+    while (prologue < entry.size() && param_load_index(entry[prologue]) >= 0) {
+        loaded[param_load_index(entry[prologue])] = entry[prologue].dest;
+        prologue++;
+    }
+    size_t param_loads = 0;
+    for (const auto& instr : func->instrs) {
+        if (param_load_index(instr) >= 0) param_loads++;
+    }
+    if (param_loads != prologue - first) return;
+
+    // Rewrite tail calls into jumps to the (not yet created) header
+    std::string header;
+    std::vector<TailCall> calls;
+    for (int b = 0; b < (int)func->blocks.size(); b++) {
+        auto& instrs = func->blocks[b].instrs;
+        int n = (int)instrs.size();
+        if (n == 0) continue;
+        int call = n - 1;
+        if (instrs[call].op == TacOp::RET) {
+            call--;
+        } else if (b + 1 != (int)func->blocks.size()) {
+            continue;  // Only a call that falls off the end of the function returns
+        }
+        const TacInstr* ret_move = nullptr;
+        if (call >= 0 && instrs[call].op == TacOp::MOVE && instrs[call].dest == "a0") {
+            ret_move = &instrs[call];
+            call--;
+        }
+        if (call < 0 || instrs[call].op != TacOp::CALL || instrs[call].src1 != func->name) continue;
+        if (ret_move ? ret_move->src1 != instrs[call].dest : !func->is_void) continue;
+
+        TailCall tail;
+        tail.block = b;
+        std::vector<int> positions;
+        if (!call_arguments(program, instrs, call, func->params.size(), tail.args, positions)) continue;
+
+        std::vector<TacInstr> kept;
+        for (int i = 0; i < call; i++) {
+            if (std::find(positions.begin(), positions.end(), i) == positions.end()) kept.push_back(instrs[i]);
+        }
+        // PHI operands must be names
+        for (auto& arg : tail.args) {
+            if (is_number(arg)) {
+                std::string temp = func->next_temp();
+                kept.push_back(TacInstr(TacOp::LOAD_IMM, temp, arg));
+                arg = temp;
+            }
+        }
+        if (header.empty()) header = func->next_label();
+        kept.push_back(TacInstr(TacOp::JUMP, "", "", header));
+        instrs = std::move(kept);
+        calls.push_back(tail);
+    }
+    if (calls.empty()) return;
+
+    // Later reads of a parameter see the PHI instead of the entry value
+    std::unordered_map<std::string, std::string> phi_of;
+    for (const auto& param : loaded) phi_of[param.second] = func->next_temp();
+    for (int b = 0; b < (int)func->blocks.size(); b++) {
+        auto& instrs = func->blocks[b].instrs;
+        for (size_t i = b == 0 ? prologue : 0; i < instrs.size(); i++) {
+            for (std::string* slot : instr_use_slots(instrs[i])) {
+                auto it = phi_of.find(*slot);
+                if (it != phi_of.end()) *slot = it->second;
+            }
+        }
+    }
+    for (auto& tail : calls) {
+        for (auto& arg : tail.args) {
+            auto it = phi_of.find(arg);
+            if (it != phi_of.end()) arg = it->second;
+        }
+    }
+    // The rest of the entry block moves into the header, and with it the
+    // edges to the entry's successors
+    const std::string entry_label = func->blocks[0].label;
+    for (auto& block : func->blocks) {
+        for (auto& instr : block.instrs) {
+            if (instr.op != TacOp::PHI) continue;
+            for (auto& arg : instr.phi_args) {
+                if (arg.first == entry_label) arg.first = header;
+            }
+        }
+    }
+
+    BasicBlock loop;
+    loop.label = header;
+    loop.instrs.push_back(TacInstr(TacOp::LABEL, "", "", header));
+    for (int index = 0; index < (int)func->params.size(); index++) {
+        auto it = loaded.find(index);
+        if (it == loaded.end()) continue;  // Never read
+        TacInstr phi(TacOp::PHI, phi_of[it->second]);
+        phi.phi_args.push_back({entry_label, it->second});
+        for (const auto& tail : calls) {
+            // A tail call in the entry block now sits in the header
+            const std::string& from = tail.block == 0 ? header : func->blocks[tail.block].label;
+            phi.phi_args.push_back({from, tail.args[index]});
+        }
+        loop.instrs.push_back(phi);
+    }
+    loop.instrs.insert(loop.instrs.end(), entry.begin() + prologue, entry.end());
+    entry.erase(entry.begin() + prologue, entry.end());
+    func->blocks.insert(func->blocks.begin() + 1, loop);
+    func->flatten_blocks();
+}
+
+} // namespace
+
+void Optimizer::tail_recursion_elimination(ProgramIR* program) {
+    for (auto& func : program->functions) {
+        eliminate_tail_calls(program, func.get());
+    }
+}